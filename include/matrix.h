@@ -3,6 +3,10 @@
 
 #include <stddef.h>
 
+/* rows allocated by matrix_ctor, matrix_eye and matrix_generate start on */
+/* a cache line; matrix_ctor_from_arr keeps the caller's rows as they are */
+#define MATRIX_CACHE_LINE 64
+
 struct Matrix {
     size_t m;    /* rows */
     size_t n;    /* cols */
@@ -39,14 +43,119 @@ void matrix_print(struct Matrix *matrix, const char *name);
 
 /* multi-threaded multiplication */
 /* nthreads == 0 -> auto detect number of processors */
+/* a C too small to feed the threads with a long inner dimension switches */
+/* the i,k,j ones (pthread, cache_friendly_most, scaled with alpha 1) and */
+/* blocked_pthread below to split-K, if its extra memory stays within */
+/* half the size of A and B */
 struct Matrix *mul_matrices_pthread(const struct Matrix *A, const struct Matrix *B, struct Matrix *C, size_t nthreads);
 struct Matrix *mul_matrices_bad_mt(const struct Matrix *A, const struct Matrix *B, struct Matrix *C, size_t nthreads);
 struct Matrix *mul_matrices_cache_friendly_mt(const struct Matrix *A, const struct Matrix *B, struct Matrix *C, size_t nthreads);
 struct Matrix *mul_matrices_cache_friendly_most_mt(const struct Matrix *A, const struct Matrix *B, struct Matrix *C, size_t nthreads);
+/* C += alpha * A * B */
+struct Matrix *mul_matrices_scaled_mt(const struct Matrix *A, const struct Matrix *B, struct Matrix *C, int alpha, size_t nthreads);
 
 /* blocked + pthreads multiplication */
 struct Matrix *mul_matrices_blocked_pthread(const struct Matrix *A, const struct Matrix *B, struct Matrix *C, size_t nthreads, size_t block_size);
 
+/* split-K multiplication: threads own ranges of the inner dimension */
+/* for small C and huge inner dimension; uses (nthreads - 1) * m * n extra ints */
+struct Matrix *mul_matrices_splitk_pthread(const struct Matrix *A, const struct Matrix *B, struct Matrix *C, size_t nthreads, size_t block_size);
+
+/* symmetric rank-k update C += A * A^T, computes one triangle of C only */
+/* mirror != 0 -> copy the computed triangle into the other one */
+enum MatrixUplo { MATRIX_UPPER = 0, MATRIX_LOWER = 1 };
+struct Matrix *mul_matrices_syrk(const struct Matrix *A, struct Matrix *C, enum MatrixUplo uplo, int mirror, size_t block_size);
+struct Matrix *mul_matrices_syrk_pthread(const struct Matrix *A, struct Matrix *C, enum MatrixUplo uplo, int mirror, size_t nthreads, size_t block_size);
+
+/* pre-packed right operand, reusable across many multiplications */
+/* the handle is read-only after packing -> safe for concurrent use */
+struct MatrixPacked;
+struct MatrixPacked *matrix_pack(const struct Matrix *B, size_t block_size);
+void matrix_packed_dtor(struct MatrixPacked *packed);
+size_t matrix_packed_footprint(const struct MatrixPacked *packed); /* bytes */
+struct Matrix *mul_matrices_packed(const struct Matrix *A, const struct MatrixPacked *B, struct Matrix *C);
+struct Matrix *mul_matrices_packed_pthread(const struct Matrix *A, const struct MatrixPacked *B, struct Matrix *C, size_t nthreads);
+
+/* asynchronous multiplication: C += A * B on background dispatchers */
+/* each job starts its own workers (blocked kernel); nthreads == 0 -> the */
+/* cores are split between the busy dispatchers, explicit counts add up */
+/* after != NULL -> run after that job (D = C * E once C = A * B is done) */
+/* cb (optional) is called from a dispatcher with the result once the */
+/* future is done, so it may poll or wait on it */
+struct MatrixFuture;
+typedef void (*matrix_future_cb)(struct Matrix *C, void *ctx);
+struct MatrixFuture *mul_matrices_submit(const struct Matrix *A, const struct Matrix *B, struct Matrix *C,
+                                         size_t nthreads, size_t block_size,
+                                         struct MatrixFuture *after, matrix_future_cb cb, void *ctx);
+int matrix_future_poll(const struct MatrixFuture *future);            /* 1 if done */
+struct Matrix *matrix_future_wait(struct MatrixFuture *future);        /* C, NULL on failure */
+void matrix_future_dtor(struct MatrixFuture *future);
+/* finish queued jobs, stop dispatchers; the next submit restarts them */
+void matrix_async_shutdown(void);
+
+/* A^p (square A) by repeated squaring, O(log p) multiplications */
+struct Matrix *matrix_pow(const struct Matrix *A, unsigned p, size_t nthreads);
+
+/* matrix-vector products on plain int arrays */
+void matrix_gemv(const struct Matrix *A, const int *x, int *y, size_t nthreads);  /* y += A * x   */
+void matrix_gevm(const int *x, const struct Matrix *A, int *y, size_t nthreads);  /* y += x^T * A */
+
+/* lazy expressions: build a tree, evaluate once */
+/* products are reordered by the matrix-chain DP, scalars and sums are */
+/* fused into the last GEMM of each product; builders take ownership of */
+/* their sub-expressions, leaves only reference their matrix */
+struct MatrixExpr;
+struct MatrixExpr *matrix_expr_leaf(const struct Matrix *matrix);
+struct MatrixExpr *matrix_expr_mul(struct MatrixExpr *lhs, struct MatrixExpr *rhs);
+struct MatrixExpr *matrix_expr_add(struct MatrixExpr *lhs, struct MatrixExpr *rhs);
+struct MatrixExpr *matrix_expr_scale(struct MatrixExpr *expr, int val);
+/* new matrix; NULL if a GEMM failed verification (see matrix_set_verify) */
+struct Matrix *matrix_expr_eval(const struct MatrixExpr *expr, size_t nthreads);
+void matrix_expr_dtor(struct MatrixExpr *expr);
+
+/* distributed multiplication over processes (SUMMA on a grid x grid grid) */
+/* pluggable message transport, all calls return 0 on success */
+struct MatrixTransport {
+    /* launcher, before the ranks are started: room for messages of max_msg bytes */
+    int (*open)(struct MatrixTransport *t, size_t nranks, size_t max_msg);
+    /* in every rank (the launcher is rank 0) */
+    int (*attach)(struct MatrixTransport *t, size_t rank);
+    /* blocking point-to-point; sizes must match on both sides */
+    int (*send)(struct MatrixTransport *t, size_t dst, const void *buf, size_t len);
+    int (*recv)(struct MatrixTransport *t, size_t src, void *buf, size_t len);
+    /* optional (NULL -> sends from root): root's buf to every other rank of */
+    /* ranks[0..nranks), called by all of them; root must be in ranks */
+    int (*bcast)(struct MatrixTransport *t, size_t root, const size_t *ranks, size_t nranks, void *buf, size_t len);
+    /* release what this process holds */
+    void (*close)(struct MatrixTransport *t);
+    void *impl;
+};
+/* POSIX shared memory for payload + local sockets for notifications; */
+/* one max_msg slot per rank in /dev/shm (about the largest operand for */
+/* SUMMA), a rank's send blocks until its previous message was received; */
+/* the launcher holds 4 descriptors per rank until the ranks attach */
+struct MatrixTransport matrix_transport_shm(void);
+/* transport == NULL -> shm transport; returns NULL, with C untouched, if */
+/* a rank failed (ranks inherit the verify mode: a failed check counts) */
+struct Matrix *mul_matrices_summa(const struct Matrix *A, const struct Matrix *B, struct Matrix *C,
+                                  size_t grid, const struct MatrixTransport *transport, size_t block_size);
+
+/* randomized result check (Freivalds), O(n^2) per round */
+/* returns 1 if C == A * B passed all rounds, 0 if C is certainly wrong */
+int matrix_verify_product(const struct Matrix *A, const struct Matrix *B, const struct Matrix *C, size_t rounds, size_t nthreads);
+/* verify mode: rounds > 0 -> the multi-threaded, blocked, split-K, packed */
+/* and (mirrored only) SYRK multiplications check their own result and */
+/* return NULL when the check fails */
+void matrix_set_verify(size_t rounds);
+size_t matrix_get_verify(void);
+
+/* opt-in timeline tracing of the parallel kernels (thread start, tiles, */
+/* packing, joins), dumped as Chrome / Perfetto trace-event JSON */
+/* events_per_thread == 0 -> default ring size; call these between multiplications */
+void matrix_trace_enable(size_t events_per_thread);
+void matrix_trace_disable(void);
+int matrix_trace_dump(const char *path);   /* 0 on success */
+
 /* etc */
 static inline struct Matrix *eye(size_t n) { return matrix_eye(n); }
 static inline void mul_val(struct Matrix *m, int v) { matrix_mul_val(m, v); }
@@ -1,11 +1,26 @@
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 #include <assert.h>
 #include <stdlib.h>
 
 #include "matrix.h"
 
+/* Zeroed row starting on a cache line, so that threads writing disjoint
+   MATRIX_CACHE_LINE-aligned column ranges never share a line. */
+static int *matrix_row_alloc(const size_t n)
+{
+    size_t bytes = n * sizeof(int);
+    bytes = (bytes + MATRIX_CACHE_LINE - 1) / MATRIX_CACHE_LINE * MATRIX_CACHE_LINE;
+
+    int *row = (int *)aligned_alloc(MATRIX_CACHE_LINE, bytes);
+    assert(row);
+    memset(row, 0, bytes);
+
+    return row;
+}
+
 struct Matrix *matrix_ctor(const size_t m, const size_t n)
 {
     assert(m && n);
@@ -19,8 +34,7 @@ struct Matrix *matrix_ctor(const size_t m, const size_t n)
 
     for (size_t row_id = 0; row_id < m; ++row_id)
     {
-        matrix->arr[row_id] = (int *)calloc(n, sizeof(int));
-        assert(matrix->arr[row_id]);
+        matrix->arr[row_id] = matrix_row_alloc(n);
     }
 
     return matrix;
@@ -40,8 +54,7 @@ struct Matrix *matrix_eye(const size_t n)
 
     for (size_t row_id = 0; row_id < n; ++row_id)
     {
-        matrix->arr[row_id] = (int *)calloc(n, sizeof(int));
-        assert(matrix->arr[row_id]);
+        matrix->arr[row_id] = matrix_row_alloc(n);
 
         matrix->arr[row_id][row_id] = 1;
     }
@@ -62,8 +75,7 @@ struct Matrix *matrix_generate(const size_t m, const size_t n, const int max_val
 
     for (size_t row_id = 0; row_id < m; ++row_id)
     {
-        matrix->arr[row_id] = (int *)calloc(n, sizeof(int));
-        assert(matrix->arr[row_id]);
+        matrix->arr[row_id] = matrix_row_alloc(n);
         for (size_t id = 0; id < n; ++id)
         {
             matrix->arr[row_id][id] = rand() % max_val;
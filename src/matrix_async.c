@@ -0,0 +1,255 @@
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <unistd.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+
+#include "matrix.h"
+#include "matrix_internal.h"
+
+/* Number of dispatcher threads. Each one runs a whole multiplication with
+   its own worker threads, so two are enough to start the next independent
+   job while the current one is finishing. Jobs submitted with nthreads == 0
+   split the cores between the dispatchers that are busy, so two of them
+   do not start 2 * ncpu workers. */
+#define ASYNC_DISPATCHERS 2
+
+/* A submitted multiplication. Reference counted: one ref for the caller
+   (dropped by matrix_future_dtor), one for the executor (dropped when the
+   job is done) and one per job that waits for it. */
+struct MatrixFuture {
+    const struct Matrix *A;
+    const struct Matrix *B;
+    struct Matrix *C;
+    size_t nthreads;
+    size_t block_size;
+
+    struct MatrixFuture *after;   /* must be done before this one starts */
+    matrix_future_cb cb;
+    void *ctx;
+
+    struct Matrix *result;        /* C, or NULL if verification failed */
+    int done;
+    size_t refs;
+
+    struct MatrixFuture *next;    /* queue link */
+};
+
+/* The executor; everything below is protected by lock. Dispatchers are
+   started by the first submit after load or after a shutdown. */
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t work;          /* new job, or a job finished */
+    pthread_cond_t finished;      /* a job finished, or a shutdown completed */
+    pthread_t dispatchers[ASYNC_DISPATCHERS];
+    size_t ndispatchers;
+    size_t running;               /* dispatchers inside a multiplication */
+    int shutdown;                 /* a shutdown is joining the dispatchers */
+
+    struct MatrixFuture *head;    /* FIFO of jobs not started yet */
+    struct MatrixFuture *tail;
+} executor = { .lock = PTHREAD_MUTEX_INITIALIZER,
+               .work = PTHREAD_COND_INITIALIZER,
+               .finished = PTHREAD_COND_INITIALIZER };
+
+/* lock must be held */
+static void future_release(struct MatrixFuture *f)
+{
+    assert(f->refs > 0);
+    if (--f->refs == 0) {
+        free(f);
+    }
+}
+
+/* First queued job whose dependency is done; lock must be held.
+   Jobs only depend on earlier submissions, so the scan cannot starve. */
+static struct MatrixFuture *take_runnable(void)
+{
+    struct MatrixFuture *prev = NULL;
+    for (struct MatrixFuture *f = executor.head; f; prev = f, f = f->next) {
+        if (f->after && !f->after->done) continue;
+
+        if (prev) prev->next = f->next;
+        else executor.head = f->next;
+        if (executor.tail == f) executor.tail = prev;
+        f->next = NULL;
+        return f;
+    }
+    return NULL;
+}
+
+static void *dispatcher(void *unused)
+{
+    (void)unused;
+
+    pthread_mutex_lock(&executor.lock);
+    for (;;) {
+        struct MatrixFuture *f = take_runnable();
+        if (!f) {
+            if (executor.shutdown && !executor.head) break;
+            pthread_cond_wait(&executor.work, &executor.lock);
+            continue;
+        }
+        /* a failed dependency means our input is garbage: fail too */
+        int skip = f->after && f->after->result == NULL;
+
+        /* more queued work -> expect every dispatcher to be busy soon */
+        size_t nthreads = f->nthreads;
+        ++executor.running;
+        if (nthreads == 0) {
+            size_t busy = executor.head ? executor.ndispatchers : executor.running;
+            nthreads = detect_threads(0) / (busy ? busy : 1);
+            if (nthreads == 0) nthreads = 1;
+        }
+        pthread_mutex_unlock(&executor.lock);
+
+        struct Matrix *result = NULL;
+        if (!skip) {
+            result = mul_matrices_blocked_pthread(f->A, f->B, f->C, nthreads, f->block_size);
+        }
+        matrix_future_cb cb = f->cb;
+        void *ctx = f->ctx;
+
+        pthread_mutex_lock(&executor.lock);
+        --executor.running;
+        f->result = result;
+        f->done = 1;
+        if (f->after) {
+            future_release(f->after);
+            f->after = NULL;
+        }
+        /* dependents may be runnable now, wake dispatchers as well */
+        pthread_cond_broadcast(&executor.work);
+        pthread_cond_broadcast(&executor.finished);
+
+        /* the result is published first, so the callback may poll or wait
+           on its own future; our ref keeps it alive until cb returns */
+        if (cb) {
+            pthread_mutex_unlock(&executor.lock);
+            cb(result, ctx);
+            pthread_mutex_lock(&executor.lock);
+        }
+        future_release(f);
+    }
+    pthread_mutex_unlock(&executor.lock);
+
+    return NULL;
+}
+
+/* lock must be held */
+static void executor_start(void)
+{
+    for (size_t t = 0; t < ASYNC_DISPATCHERS; ++t) {
+        if (pthread_create(&executor.dispatchers[executor.ndispatchers], NULL, dispatcher, NULL) == 0) {
+            ++executor.ndispatchers;
+        }
+    }
+    assert(executor.ndispatchers > 0);
+}
+
+/* Queue C += A * B (blocked multi-threaded kernel) and return at once.
+   after != NULL -> start only once after is done, e.g. D = C * E after
+   C = A * B. cb, if given, runs on the dispatcher thread with the result
+   (C, or NULL on failure) once the future is done; dependent jobs may
+   already be running by then. */
+struct MatrixFuture *mul_matrices_submit(const struct Matrix *A, const struct Matrix *B, struct Matrix *C,
+                                         size_t nthreads, size_t block_size,
+                                         struct MatrixFuture *after, matrix_future_cb cb, void *ctx)
+{
+    assert(A && B && C);
+    assert(A->n == B->m && A->m == C->m && B->n == C->n);
+
+    struct MatrixFuture *f = (struct MatrixFuture *)calloc(1, sizeof(struct MatrixFuture));
+    assert(f);
+
+    f->A = A;
+    f->B = B;
+    f->C = C;
+    f->nthreads = nthreads;
+    f->block_size = block_size;
+    f->cb = cb;
+    f->ctx = ctx;
+    f->refs = 2;
+
+    pthread_mutex_lock(&executor.lock);
+    while (executor.shutdown) {
+        pthread_cond_wait(&executor.finished, &executor.lock);
+    }
+    if (executor.ndispatchers == 0) {
+        executor_start();
+    }
+    if (after) {
+        f->after = after;
+        ++after->refs;
+    }
+    if (executor.tail) executor.tail->next = f;
+    else executor.head = f;
+    executor.tail = f;
+    pthread_cond_signal(&executor.work);
+    pthread_mutex_unlock(&executor.lock);
+
+    return f;
+}
+
+int matrix_future_poll(const struct MatrixFuture *f)
+{
+    assert(f);
+
+    pthread_mutex_lock(&executor.lock);
+    int done = f->done;
+    pthread_mutex_unlock(&executor.lock);
+
+    return done;
+}
+
+struct Matrix *matrix_future_wait(struct MatrixFuture *f)
+{
+    assert(f);
+
+    pthread_mutex_lock(&executor.lock);
+    while (!f->done) {
+        pthread_cond_wait(&executor.finished, &executor.lock);
+    }
+    struct Matrix *result = f->result;
+    pthread_mutex_unlock(&executor.lock);
+
+    return result;
+}
+
+/* Drops the caller's handle; a job that is still queued keeps running */
+void matrix_future_dtor(struct MatrixFuture *f)
+{
+    assert(f);
+
+    pthread_mutex_lock(&executor.lock);
+    future_release(f);
+    pthread_mutex_unlock(&executor.lock);
+}
+
+/* Runs everything already queued, then stops the dispatchers. A later
+   submit starts them again; submits racing with the shutdown wait for it. */
+void matrix_async_shutdown(void)
+{
+    pthread_mutex_lock(&executor.lock);
+    while (executor.shutdown) {
+        pthread_cond_wait(&executor.finished, &executor.lock);
+    }
+    executor.shutdown = 1;
+    pthread_cond_broadcast(&executor.work);
+    size_t n = executor.ndispatchers;
+    pthread_mutex_unlock(&executor.lock);
+
+    /* nobody touches dispatchers[] while shutdown is set */
+    for (size_t t = 0; t < n; ++t) {
+        pthread_join(executor.dispatchers[t], NULL);
+    }
+
+    pthread_mutex_lock(&executor.lock);
+    executor.ndispatchers = 0;
+    executor.shutdown = 0;
+    pthread_cond_broadcast(&executor.finished);
+    pthread_mutex_unlock(&executor.lock);
+}
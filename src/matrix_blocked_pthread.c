@@ -8,8 +8,7 @@
 #include <stdlib.h>
 
 #include "matrix.h"
-
-static inline size_t min_sz(size_t a, size_t b) { return a < b ? a : b; }
+#include "matrix_internal.h"
 
 /* Worker args for blocked parallel multiplication */
 struct BlockMtArg {
@@ -19,6 +18,7 @@ struct BlockMtArg {
     size_t block_size;
     size_t block_row_begin;
     size_t block_row_end;
+    uint64_t t_spawn;   /* trace: when the launcher created this thread */
 };
 
 /* Worker: compute assigned block-rows [block_row_begin, block_row_end) */
@@ -34,8 +34,11 @@ static void *block_mt_worker(void *varg)
     const size_t K = A->n; // = B->m
     const size_t N = B->n;
 
+    matrix_trace_end("thread_start", arg->t_spawn, arg->block_row_begin, arg->block_row_end);
+
     /* iterate over block rows assigned to this thread */
     for (size_t bi = arg->block_row_begin; bi < arg->block_row_end; ++bi) {
+        uint64_t t_row = matrix_trace_begin();
         size_t ii = bi * bs;
         size_t i_max = min_sz(ii + bs, M);
 
@@ -65,6 +68,7 @@ static void *block_mt_worker(void *varg)
                 }
             }
         }
+        matrix_trace_end("block_row", t_row, bi, i_max - ii);
     }
 
     return NULL;
@@ -80,19 +84,26 @@ struct Matrix *mul_matrices_blocked_pthread(const struct Matrix *A, const struct
         block_size = 32;
     }
 
-    if (nthreads == 0) {
-        long procs = sysconf(_SC_NPROCESSORS_ONLN);
-        if (procs > 0) nthreads = (size_t)procs;
-        else nthreads = 1;
+    nthreads = detect_threads(nthreads);
+
+    /* too few tiles of C to feed the threads, but a long inner dimension:
+       split K instead of the rows */
+    size_t c_tiles = ((A->m + block_size - 1) / block_size) * ((B->n + block_size - 1) / block_size);
+    if (nthreads > 1 && c_tiles * 2 <= nthreads && A->n >= nthreads * block_size &&
+        splitk_fits(A, B, nthreads)) {
+        return mul_matrices_splitk_pthread(A, B, C, nthreads, block_size);
     }
-    if (nthreads == 0) nthreads = 1;
+
+    struct MatrixVerify verify;
+    matrix_verify_begin(&verify, C, 1, 1, nthreads);
 
     /* quick single-thread fallback (avoid thread overhead for small work) */
     if (nthreads == 1) {
         /* emulate worker over all block rows */
-        struct BlockMtArg single = { A, B, C, block_size, 0, (A->m + block_size - 1) / block_size };
+        struct BlockMtArg single = { .A = A, .B = B, .C = C, .block_size = block_size,
+                                     .block_row_begin = 0, .block_row_end = (A->m + block_size - 1) / block_size };
         block_mt_worker(&single);
-        return C;
+        return matrix_verify_end(&verify, A, B, C, nthreads);
     }
 
     size_t block_rows = (A->m + block_size - 1) / block_size;
@@ -107,6 +118,7 @@ struct Matrix *mul_matrices_blocked_pthread(const struct Matrix *A, const struct
     size_t base = block_rows / nthreads;
     size_t rem = block_rows % nthreads;
     size_t cur_block = 0;
+    uint64_t t_create = matrix_trace_begin();
     for (size_t t = 0; t < nthreads; ++t) {
         size_t my_blocks = base + (t < rem ? 1 : 0);
         args[t].A = A;
@@ -118,6 +130,7 @@ struct Matrix *mul_matrices_blocked_pthread(const struct Matrix *A, const struct
         cur_block += my_blocks;
 
         if (args[t].block_row_begin < args[t].block_row_end) {
+            args[t].t_spawn = matrix_trace_begin();
             int rc = pthread_create(&threads[t], NULL, block_mt_worker, &args[t]);
             if (rc != 0) {
                 /* fallback run in main thread */
@@ -129,13 +142,17 @@ struct Matrix *mul_matrices_blocked_pthread(const struct Matrix *A, const struct
         }
     }
 
+    matrix_trace_end("block_create", t_create, nthreads, block_rows);
+
+    uint64_t t_join = matrix_trace_begin();
     for (size_t t = 0; t < nthreads; ++t) {
         if (threads[t]) pthread_join(threads[t], NULL);
     }
+    matrix_trace_end("block_join", t_join, nthreads, block_rows);
 
     free(threads);
     free(args);
-    return C;
+    return matrix_verify_end(&verify, A, B, C, nthreads);
 }
 
 /* Single-threaded blocked wrapper */
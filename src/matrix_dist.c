@@ -0,0 +1,360 @@
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <stdlib.h>
+
+#include "matrix.h"
+
+/* SUMMA on a q x q grid of processes.
+
+   Rank (r, c) owns block A(r, c), B(r, c) and C(r, c) of a q x q split of
+   each matrix. In step k, A(r, k) is broadcast along grid row r and B(k, c)
+   along grid column c, and every rank does C(r, c) += A(r, k) * B(k, c)
+   with the local blocked kernel. A communication thread runs the
+   broadcasts of step k + 1 into the second half of a double buffer while
+   the compute thread multiplies step k. Finally all blocks of C are sent
+   to rank 0, which is the calling process. */
+
+static inline size_t chunk_begin(size_t len, size_t q, size_t idx)
+{
+    size_t base = len / q;
+    size_t rem = len % q;
+    return idx * base + (idx < rem ? idx : rem);
+}
+
+static inline size_t chunk_size(size_t len, size_t q, size_t idx)
+{
+    return len / q + (idx < len % q ? 1 : 0);
+}
+
+struct SummaRank {
+    const struct Matrix *A;
+    const struct Matrix *B;
+    struct MatrixTransport *tr;
+    size_t q;
+    size_t row;
+    size_t col;
+    size_t block_size;
+
+    size_t m_loc;           /* rows of my A and C blocks */
+    size_t n_loc;           /* cols of my B and C blocks */
+    int *a_loc;             /* A(row, col), m_loc x chunk_size(K, q, col) */
+    int *b_loc;             /* B(row, col), chunk_size(K, q, row) x n_loc */
+    int *c_loc;             /* C(row, col), m_loc x n_loc */
+    int *a_buf[2];          /* A(row, k) panels */
+    int *b_buf[2];          /* B(k, col) panels */
+    size_t *group;          /* q ranks of the current broadcast */
+
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int full[2];            /* slot holds the panels of a step not multiplied yet */
+    int error;
+};
+
+static inline size_t rank_of(size_t q, size_t r, size_t c) { return r * q + c; }
+
+/* Copies rows [r0, r0 + m) x cols [c0, c0 + n) of M into dst, row-major */
+static void extract_block(const struct Matrix *M, size_t r0, size_t m, size_t c0, size_t n, int *dst)
+{
+    for (size_t i = 0; i < m; ++i) {
+        memcpy(dst + i * n, M->arr[r0 + i] + c0, n * sizeof(int));
+    }
+}
+
+/* Broadcast of len bytes inside one grid row (along_row) or column; flat
+   sends from the root if the transport has no bcast of its own */
+static int summa_bcast(struct SummaRank *sr, int along_row, size_t root_idx, void *buf, size_t len)
+{
+    size_t me = along_row ? sr->col : sr->row;
+    size_t my_rank = rank_of(sr->q, sr->row, sr->col);
+
+    if (sr->tr->bcast) {
+        for (size_t i = 0; i < sr->q; ++i) {
+            sr->group[i] = along_row ? rank_of(sr->q, sr->row, i) : rank_of(sr->q, i, sr->col);
+        }
+        return sr->tr->bcast(sr->tr, sr->group[root_idx], sr->group, sr->q, buf, len);
+    }
+
+    if (me != root_idx) {
+        size_t root = along_row ? rank_of(sr->q, sr->row, root_idx) : rank_of(sr->q, root_idx, sr->col);
+        return sr->tr->recv(sr->tr, root, buf, len);
+    }
+    for (size_t i = 0; i < sr->q; ++i) {
+        size_t peer = along_row ? rank_of(sr->q, sr->row, i) : rank_of(sr->q, i, sr->col);
+        if (peer == my_rank) continue;
+        if (sr->tr->send(sr->tr, peer, buf, len) != 0) return -1;
+    }
+    return 0;
+}
+
+static void *summa_comm_thread(void *varg)
+{
+    struct SummaRank *sr = (struct SummaRank *)varg;
+    const size_t K = sr->A->n;
+
+    for (size_t k = 0; k < sr->q; ++k) {
+        size_t slot = k % 2;
+
+        pthread_mutex_lock(&sr->lock);
+        while (sr->full[slot] && !sr->error) {
+            pthread_cond_wait(&sr->cond, &sr->lock);
+        }
+        int stop = sr->error;
+        pthread_mutex_unlock(&sr->lock);
+        if (stop) break;
+
+        size_t k_loc = chunk_size(K, sr->q, k);
+        size_t a_bytes = sr->m_loc * k_loc * sizeof(int);
+        size_t b_bytes = k_loc * sr->n_loc * sizeof(int);
+
+        /* the roots multiply from their own blocks: copy them into the panel */
+        if (sr->col == k) memcpy(sr->a_buf[slot], sr->a_loc, a_bytes);
+        if (sr->row == k) memcpy(sr->b_buf[slot], sr->b_loc, b_bytes);
+
+        int rc = summa_bcast(sr, 1, k, sr->a_buf[slot], a_bytes);
+        if (rc == 0) rc = summa_bcast(sr, 0, k, sr->b_buf[slot], b_bytes);
+
+        pthread_mutex_lock(&sr->lock);
+        if (rc != 0) sr->error = 1;
+        else sr->full[slot] = 1;
+        pthread_cond_broadcast(&sr->cond);
+        pthread_mutex_unlock(&sr->lock);
+        if (rc != 0) break;
+    }
+
+    return NULL;
+}
+
+/* C(row, col) += A(row, k) * B(k, col) for all k, overlapped with the comm thread */
+static int summa_compute(struct SummaRank *sr)
+{
+    const size_t K = sr->A->n;
+    size_t k_max = 0;
+    for (size_t k = 0; k < sr->q; ++k) {
+        if (chunk_size(K, sr->q, k) > k_max) k_max = chunk_size(K, sr->q, k);
+    }
+
+    /* views for the local blocked kernel: row pointers into flat buffers */
+    int **a_rows = (int **)calloc(sr->m_loc, sizeof(int *));
+    int **b_rows = (int **)calloc(k_max, sizeof(int *));
+    int **c_rows = (int **)calloc(sr->m_loc, sizeof(int *));
+    assert(a_rows && b_rows && c_rows);
+    for (size_t i = 0; i < sr->m_loc; ++i) {
+        c_rows[i] = sr->c_loc + i * sr->n_loc;
+    }
+    struct Matrix c_view = { sr->m_loc, sr->n_loc, c_rows };
+
+    int error = 0;
+    for (size_t k = 0; k < sr->q && !error; ++k) {
+        size_t slot = k % 2;
+
+        pthread_mutex_lock(&sr->lock);
+        while (!sr->full[slot] && !sr->error) {
+            pthread_cond_wait(&sr->cond, &sr->lock);
+        }
+        error = sr->error;
+        pthread_mutex_unlock(&sr->lock);
+        if (error) break;
+
+        size_t k_loc = chunk_size(K, sr->q, k);
+        for (size_t i = 0; i < sr->m_loc; ++i) {
+            a_rows[i] = sr->a_buf[slot] + i * k_loc;
+        }
+        for (size_t i = 0; i < k_loc; ++i) {
+            b_rows[i] = sr->b_buf[slot] + i * sr->n_loc;
+        }
+        struct Matrix a_view = { sr->m_loc, k_loc, a_rows };
+        struct Matrix b_view = { k_loc, sr->n_loc, b_rows };
+
+        /* NULL only if the inherited verify mode caught a wrong product */
+        struct Matrix *res = mul_matrices_blocked(&a_view, &b_view, &c_view, sr->block_size);
+
+        pthread_mutex_lock(&sr->lock);
+        if (!res) sr->error = 1;
+        error = sr->error;
+        sr->full[slot] = 0;
+        pthread_cond_broadcast(&sr->cond);
+        pthread_mutex_unlock(&sr->lock);
+    }
+
+    free(c_rows);
+    free(b_rows);
+    free(a_rows);
+    return error ? -1 : 0;
+}
+
+/* Whole life of one rank; rank 0 also collects the product into c_all
+   (M x N, row-major). 0 on success. */
+static int summa_rank(const struct Matrix *A, const struct Matrix *B, int *c_all,
+                      struct MatrixTransport *tr, size_t q, size_t rank, size_t block_size)
+{
+    const size_t M = A->m;
+    const size_t K = A->n;
+    const size_t N = B->n;
+
+    if (tr->attach(tr, rank) != 0) return -1;
+
+    struct SummaRank sr;
+    memset(&sr, 0, sizeof(sr));
+    sr.A = A;
+    sr.B = B;
+    sr.tr = tr;
+    sr.q = q;
+    sr.row = rank / q;
+    sr.col = rank % q;
+    sr.block_size = block_size;
+    sr.m_loc = chunk_size(M, q, sr.row);
+    sr.n_loc = chunk_size(N, q, sr.col);
+    pthread_mutex_init(&sr.lock, NULL);
+    pthread_cond_init(&sr.cond, NULL);
+
+    size_t k_max = chunk_size(K, q, 0);     /* the first chunk is the largest */
+    size_t ka = chunk_size(K, q, sr.col);
+    size_t kb = chunk_size(K, q, sr.row);
+
+    /* scatter: every rank cuts its blocks out of its (inherited) copy */
+    sr.a_loc = (int *)malloc(sr.m_loc * ka * sizeof(int));
+    sr.b_loc = (int *)malloc(kb * sr.n_loc * sizeof(int));
+    sr.c_loc = (int *)calloc(sr.m_loc * sr.n_loc, sizeof(int));
+    sr.group = (size_t *)calloc(q, sizeof(size_t));
+    assert(sr.a_loc && sr.b_loc && sr.c_loc && sr.group);
+    extract_block(A, chunk_begin(M, q, sr.row), sr.m_loc, chunk_begin(K, q, sr.col), ka, sr.a_loc);
+    extract_block(B, chunk_begin(K, q, sr.row), kb, chunk_begin(N, q, sr.col), sr.n_loc, sr.b_loc);
+    for (size_t s = 0; s < 2; ++s) {
+        sr.a_buf[s] = (int *)malloc(sr.m_loc * k_max * sizeof(int));
+        sr.b_buf[s] = (int *)malloc(k_max * sr.n_loc * sizeof(int));
+        assert(sr.a_buf[s] && sr.b_buf[s]);
+    }
+
+    int rc = 0;
+    pthread_t comm;
+    if (pthread_create(&comm, NULL, summa_comm_thread, &sr) != 0) {
+        rc = -1;
+    } else {
+        rc = summa_compute(&sr);
+        pthread_join(comm, NULL);
+        if (sr.error) rc = -1;
+    }
+
+    /* gather the product on rank 0 */
+    if (rc == 0 && rank != 0) {
+        rc = tr->send(tr, 0, sr.c_loc, sr.m_loc * sr.n_loc * sizeof(int));
+    } else if (rc == 0) {
+        int *buf = (int *)malloc(chunk_size(M, q, 0) * chunk_size(N, q, 0) * sizeof(int));
+        assert(buf);
+        for (size_t r = 0; r < q * q && rc == 0; ++r) {
+            size_t br = r / q, bc = r % q;
+            size_t m = chunk_size(M, q, br), n = chunk_size(N, q, bc);
+            size_t i0 = chunk_begin(M, q, br), j0 = chunk_begin(N, q, bc);
+            const int *blk = sr.c_loc;
+            if (r != 0) {
+                rc = tr->recv(tr, r, buf, m * n * sizeof(int));
+                blk = buf;
+            }
+            for (size_t i = 0; i < m && rc == 0; ++i) {
+                memcpy(c_all + (i0 + i) * N + j0, blk + i * n, n * sizeof(int));
+            }
+        }
+        free(buf);
+    }
+
+    for (size_t s = 0; s < 2; ++s) {
+        free(sr.a_buf[s]);
+        free(sr.b_buf[s]);
+    }
+    free(sr.group);
+    free(sr.c_loc);
+    free(sr.b_loc);
+    free(sr.a_loc);
+    pthread_cond_destroy(&sr.cond);
+    pthread_mutex_destroy(&sr.lock);
+    return rc;
+}
+
+/* C += A * B on grid x grid processes forked from the caller, which acts
+   as rank 0. transport == NULL -> matrix_transport_shm(). Processes only
+   talk through the transport, so another backend can move the ranks to
+   other machines. The caller should not hold locks other threads may need
+   in the children (fork copies only the calling thread). The ranks inherit
+   the verify mode, a failed check fails the rank. Returns C, or NULL if a
+   rank could not be started or failed; C is only updated on success. */
+struct Matrix *mul_matrices_summa(const struct Matrix *A, const struct Matrix *B, struct Matrix *C,
+                                  size_t grid, const struct MatrixTransport *transport, size_t block_size)
+{
+    assert(A && B && C);
+    assert(A->n == B->m && A->m == C->m && B->n == C->n);
+
+    if (grid == 0) grid = 1;
+    assert(grid <= A->m && grid <= A->n && grid <= B->n);
+    if (block_size == 0) block_size = 32;
+
+    struct MatrixTransport tr = transport ? *transport : matrix_transport_shm();
+    const size_t q = grid;
+    const size_t nranks = q * q;
+
+    /* largest message: the first chunks of each split are the largest */
+    size_t m0 = chunk_size(A->m, q, 0), k0 = chunk_size(A->n, q, 0), n0 = chunk_size(B->n, q, 0);
+    size_t max_msg = m0 * k0;
+    if (k0 * n0 > max_msg) max_msg = k0 * n0;
+    if (m0 * n0 > max_msg) max_msg = m0 * n0;
+    max_msg *= sizeof(int);
+
+    if (tr.open(&tr, nranks, max_msg) != 0) {
+        perror("[summa] transport open");
+        return NULL;
+    }
+
+    pid_t *pids = (pid_t *)calloc(nranks, sizeof(pid_t));
+    int *c_all = (int *)malloc(A->m * B->n * sizeof(int));
+    assert(pids && c_all);
+
+    /* don't let the children flush our buffered output again */
+    fflush(stdout);
+    fflush(stderr);
+
+    int ok = 1;
+    size_t started = 1;
+    for (size_t r = 1; r < nranks; ++r, ++started) {
+        pid_t pid = fork();
+        if (pid < 0) {
+            perror("[summa] fork");
+            ok = 0;
+            break;
+        }
+        if (pid == 0) {
+            int rc = summa_rank(A, B, NULL, &tr, q, r, block_size);
+            tr.close(&tr);
+            _exit(rc == 0 ? 0 : 1);
+        }
+        pids[r] = pid;
+    }
+
+    /* on a failed fork closing our ends makes the started ranks bail out */
+    if (ok) ok = summa_rank(A, B, c_all, &tr, q, 0, block_size) == 0;
+    tr.close(&tr);
+
+    for (size_t r = 1; r < started; ++r) {
+        int status = 0;
+        if (waitpid(pids[r], &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            ok = 0;
+        }
+    }
+
+    /* only now is it known that every rank succeeded */
+    for (size_t i = 0; i < C->m && ok; ++i) {
+        for (size_t j = 0; j < C->n; ++j) {
+            C->arr[i][j] += c_all[i * C->n + j];
+        }
+    }
+
+    free(c_all);
+    free(pids);
+    return ok ? C : NULL;
+}
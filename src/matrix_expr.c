@@ -0,0 +1,330 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+
+#include "matrix.h"
+
+/* Lazy matrix expressions.
+
+   Building an expression only records the tree. matrix_expr_eval() then
+     - flattens every product A * B * ... * Z (pulling scalars out of it)
+       and picks its parenthesization with the matrix-chain DP;
+     - runs each last GEMM of a chain as out += alpha * L * R
+       (mul_matrices_scaled_mt), so scaling and summation are done in the
+       GEMM epilogue instead of separate passes over the result;
+     - takes intermediates from a pool keyed by shape, so a buffer freed by
+       one step is reused by the next step of the same shape. */
+
+enum ExprKind {
+    EXPR_LEAF,
+    EXPR_MUL,
+    EXPR_ADD,
+    EXPR_SCALE,
+};
+
+struct MatrixExpr {
+    enum ExprKind kind;
+    size_t m;
+    size_t n;
+    const struct Matrix *leaf;  /* EXPR_LEAF, not owned */
+    struct MatrixExpr *lhs;     /* owned */
+    struct MatrixExpr *rhs;     /* owned, EXPR_MUL / EXPR_ADD only */
+    int val;                    /* EXPR_SCALE */
+};
+
+static struct MatrixExpr *expr_new(enum ExprKind kind, size_t m, size_t n)
+{
+    struct MatrixExpr *e = (struct MatrixExpr *)calloc(1, sizeof(struct MatrixExpr));
+    assert(e);
+
+    e->kind = kind;
+    e->m = m;
+    e->n = n;
+    return e;
+}
+
+struct MatrixExpr *matrix_expr_leaf(const struct Matrix *matrix)
+{
+    assert(matrix);
+
+    struct MatrixExpr *e = expr_new(EXPR_LEAF, matrix->m, matrix->n);
+    e->leaf = matrix;
+    return e;
+}
+
+struct MatrixExpr *matrix_expr_mul(struct MatrixExpr *lhs, struct MatrixExpr *rhs)
+{
+    assert(lhs && rhs);
+    assert(lhs->n == rhs->m);
+
+    struct MatrixExpr *e = expr_new(EXPR_MUL, lhs->m, rhs->n);
+    e->lhs = lhs;
+    e->rhs = rhs;
+    return e;
+}
+
+struct MatrixExpr *matrix_expr_add(struct MatrixExpr *lhs, struct MatrixExpr *rhs)
+{
+    assert(lhs && rhs);
+    assert(lhs->m == rhs->m && lhs->n == rhs->n);
+
+    struct MatrixExpr *e = expr_new(EXPR_ADD, lhs->m, lhs->n);
+    e->lhs = lhs;
+    e->rhs = rhs;
+    return e;
+}
+
+struct MatrixExpr *matrix_expr_scale(struct MatrixExpr *expr, int val)
+{
+    assert(expr);
+
+    struct MatrixExpr *e = expr_new(EXPR_SCALE, expr->m, expr->n);
+    e->lhs = expr;
+    e->val = val;
+    return e;
+}
+
+void matrix_expr_dtor(struct MatrixExpr *expr)
+{
+    if (!expr) return;
+
+    matrix_expr_dtor(expr->lhs);
+    matrix_expr_dtor(expr->rhs);
+    free(expr);
+}
+
+/* ---------------- intermediate buffer pool ---------------- */
+
+struct BufPool {
+    struct Matrix **free_list;
+    size_t count;
+    size_t cap;
+};
+
+/* zeroed m x n buffer, reusing a released one of the same shape if any */
+static struct Matrix *pool_get(struct BufPool *pool, size_t m, size_t n)
+{
+    for (size_t i = 0; i < pool->count; ++i) {
+        struct Matrix *buf = pool->free_list[i];
+        if (buf->m == m && buf->n == n) {
+            pool->free_list[i] = pool->free_list[--pool->count];
+            matrix_fill(buf, 0);
+            return buf;
+        }
+    }
+    return matrix_ctor(m, n);
+}
+
+static void pool_put(struct BufPool *pool, struct Matrix *buf)
+{
+    if (pool->count == pool->cap) {
+        pool->cap = pool->cap ? pool->cap * 2 : 8;
+        pool->free_list = (struct Matrix **)realloc(pool->free_list, pool->cap * sizeof(struct Matrix *));
+        assert(pool->free_list);
+    }
+    pool->free_list[pool->count++] = buf;
+}
+
+static void pool_dtor(struct BufPool *pool)
+{
+    for (size_t i = 0; i < pool->count; ++i) {
+        matrix_dtor(pool->free_list[i]);
+    }
+    free(pool->free_list);
+}
+
+/* ---------------- evaluation ---------------- */
+
+struct EvalCtx {
+    struct BufPool pool;
+    size_t nthreads;
+    int failed;         /* a GEMM failed verification (see matrix_set_verify) */
+};
+
+/* One factor of a flattened product chain */
+struct ChainFactor {
+    const struct Matrix *matrix;
+    int owned;                  /* matrix is a pool buffer */
+};
+
+struct Chain {
+    struct ChainFactor *factors;
+    size_t len;
+    size_t cap;
+    int alpha;                  /* product of all scalars met while flattening */
+    size_t *split;              /* len x len, best split point of [i, j] */
+};
+
+static void eval_into(struct EvalCtx *ctx, const struct MatrixExpr *e, struct Matrix *out, int alpha);
+
+static void chain_push(struct Chain *chain, const struct Matrix *matrix, int owned)
+{
+    if (chain->len == chain->cap) {
+        chain->cap = chain->cap ? chain->cap * 2 : 8;
+        chain->factors = (struct ChainFactor *)realloc(chain->factors, chain->cap * sizeof(struct ChainFactor));
+        assert(chain->factors);
+    }
+    chain->factors[chain->len].matrix = matrix;
+    chain->factors[chain->len].owned = owned;
+    ++chain->len;
+}
+
+/* Flattens nested products and scalings; sums become materialized factors */
+static void chain_flatten(struct EvalCtx *ctx, struct Chain *chain, const struct MatrixExpr *e)
+{
+    switch (e->kind) {
+    case EXPR_MUL:
+        chain_flatten(ctx, chain, e->lhs);
+        chain_flatten(ctx, chain, e->rhs);
+        break;
+    case EXPR_SCALE:
+        chain->alpha *= e->val;
+        chain_flatten(ctx, chain, e->lhs);
+        break;
+    case EXPR_LEAF:
+        chain_push(chain, e->leaf, 0);
+        break;
+    case EXPR_ADD: {
+        struct Matrix *buf = pool_get(&ctx->pool, e->m, e->n);
+        eval_into(ctx, e, buf, 1);
+        chain_push(chain, buf, 1);
+        break;
+    }
+    }
+}
+
+/* Matrix-chain DP: cost[i][j] = min over s of cost[i][s] + cost[s+1][j]
+   + p[i] * p[s+1] * p[j+1], where factor i is p[i] x p[i+1]. */
+static void chain_order(struct Chain *chain)
+{
+    const size_t len = chain->len;
+    size_t *p = (size_t *)calloc(len + 1, sizeof(size_t));
+    double *cost = (double *)calloc(len * len, sizeof(double));
+    chain->split = (size_t *)calloc(len * len, sizeof(size_t));
+    assert(p && cost && chain->split);
+
+    for (size_t i = 0; i < len; ++i) {
+        p[i] = chain->factors[i].matrix->m;
+    }
+    p[len] = chain->factors[len - 1].matrix->n;
+
+    /* double: flop counts of long chains overflow size_t quickly */
+    for (size_t span = 1; span < len; ++span) {
+        for (size_t i = 0; i + span < len; ++i) {
+            size_t j = i + span;
+            double best = -1.0;
+            for (size_t s = i; s < j; ++s) {
+                double c = cost[i * len + s] + cost[(s + 1) * len + j] + (double)p[i] * p[s + 1] * p[j + 1];
+                if (best < 0.0 || c < best) {
+                    best = c;
+                    chain->split[i * len + j] = s;
+                }
+            }
+            cost[i * len + j] = best;
+        }
+    }
+
+    free(cost);
+    free(p);
+}
+
+/* Product of factors [i, j]. A single factor is returned as is; otherwise
+   the result is a pool buffer (*owned = 1). */
+static const struct Matrix *chain_eval(struct EvalCtx *ctx, struct Chain *chain, size_t i, size_t j, int *owned)
+{
+    if (i == j) {
+        *owned = chain->factors[i].owned;
+        chain->factors[i].owned = 0;    /* the caller releases it now */
+        return chain->factors[i].matrix;
+    }
+
+    size_t s = chain->split[i * chain->len + j];
+    int l_owned = 0, r_owned = 0;
+    const struct Matrix *L = chain_eval(ctx, chain, i, s, &l_owned);
+    const struct Matrix *R = chain_eval(ctx, chain, s + 1, j, &r_owned);
+
+    struct Matrix *out = pool_get(&ctx->pool, L->m, R->n);
+    if (!mul_matrices_scaled_mt(L, R, out, 1, ctx->nthreads)) {
+        ctx->failed = 1;
+    }
+
+    if (l_owned) pool_put(&ctx->pool, (struct Matrix *)L);
+    if (r_owned) pool_put(&ctx->pool, (struct Matrix *)R);
+
+    *owned = 1;
+    return out;
+}
+
+/* out += alpha * (L * R), the top split of a chain goes straight into out */
+static void chain_eval_into(struct EvalCtx *ctx, struct Chain *chain, struct Matrix *out, int alpha)
+{
+    const size_t len = chain->len;
+    int l_owned = 0, r_owned = 0;
+
+    if (len == 1) {
+        const struct Matrix *M = chain_eval(ctx, chain, 0, 0, &l_owned);
+        for (size_t i = 0; i < out->m; ++i) {
+            for (size_t j = 0; j < out->n; ++j) {
+                out->arr[i][j] += alpha * M->arr[i][j];
+            }
+        }
+        if (l_owned) pool_put(&ctx->pool, (struct Matrix *)M);
+        return;
+    }
+
+    size_t s = chain->split[len - 1];   /* split[0 * len + len - 1] */
+    const struct Matrix *L = chain_eval(ctx, chain, 0, s, &l_owned);
+    const struct Matrix *R = chain_eval(ctx, chain, s + 1, len - 1, &r_owned);
+
+    if (!mul_matrices_scaled_mt(L, R, out, alpha, ctx->nthreads)) {
+        ctx->failed = 1;
+    }
+
+    if (l_owned) pool_put(&ctx->pool, (struct Matrix *)L);
+    if (r_owned) pool_put(&ctx->pool, (struct Matrix *)R);
+}
+
+/* out += alpha * value(e); does nothing once ctx->failed is set */
+static void eval_into(struct EvalCtx *ctx, const struct MatrixExpr *e, struct Matrix *out, int alpha)
+{
+    if (ctx->failed) return;
+
+    switch (e->kind) {
+    case EXPR_ADD:
+        eval_into(ctx, e->lhs, out, alpha);
+        eval_into(ctx, e->rhs, out, alpha);
+        break;
+    case EXPR_SCALE:
+        eval_into(ctx, e->lhs, out, alpha * e->val);
+        break;
+    case EXPR_LEAF:
+    case EXPR_MUL: {
+        struct Chain chain = { NULL, 0, 0, alpha, NULL };
+        chain_flatten(ctx, &chain, e);
+        chain_order(&chain);
+        chain_eval_into(ctx, &chain, out, chain.alpha);
+        free(chain.split);
+        free(chain.factors);
+        break;
+    }
+    }
+}
+
+struct Matrix *matrix_expr_eval(const struct MatrixExpr *expr, size_t nthreads)
+{
+    assert(expr);
+
+    struct EvalCtx ctx = { { NULL, 0, 0 }, nthreads, 0 };
+    struct Matrix *result = matrix_ctor(expr->m, expr->n);
+
+    eval_into(&ctx, expr, result, 1);
+
+    pool_dtor(&ctx.pool);
+    if (ctx.failed) {
+        matrix_dtor(result);
+        return NULL;
+    }
+    return result;
+}
@@ -0,0 +1,69 @@
+#ifndef MATRIX_INTERNAL_H
+#define MATRIX_INTERNAL_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include "matrix.h"
+
+/* columns of int per cache line: column chunks are multiples of this */
+#define COLS_PER_LINE (MATRIX_CACHE_LINE / sizeof(int))
+
+static inline size_t min_sz(size_t a, size_t b) { return a < b ? a : b; }
+
+/* nthreads == 0 -> number of online processors; never returns 0 */
+static inline size_t detect_threads(size_t nthreads)
+{
+    if (nthreads == 0) {
+        long procs = sysconf(_SC_NPROCESSORS_ONLN);
+        if (procs > 0) nthreads = (size_t)procs;
+        else nthreads = 1;
+    }
+    return nthreads ? nthreads : 1;
+}
+
+/* The automatic switch to split-K for a small C and a long inner dimension
+   only happens while its (nthreads - 1) * m * n ints of partial sums stay
+   within half the size of the operands */
+static inline int splitk_fits(const struct Matrix *A, const struct Matrix *B, size_t nthreads)
+{
+    return (nthreads - 1) * A->m * B->n <= A->n * (A->m + B->n) / 2;
+}
+
+/* Verify mode bookkeeping for one multiplication (see matrix_set_verify).
+   begin() snapshots C * x for the random vectors before C is touched,
+   end() checks alpha * A * (B * x) + C_old * x == C_new * x and returns C,
+   or NULL when the check fails. Both are no-ops while verify mode is off. */
+struct MatrixVerify {
+    size_t rounds;      /* 0 -> verify mode was off at begin() */
+    int alpha;          /* the kernel computes C += alpha * A * B */
+    unsigned *x;        /* rounds x C->n random 0/1 vectors */
+    unsigned *c0x;      /* rounds x C->m, C_old * x (zero if C is overwritten) */
+};
+
+void matrix_verify_begin(struct MatrixVerify *v, const struct Matrix *C, int accumulates, int alpha, size_t nthreads);
+struct Matrix *matrix_verify_end(struct MatrixVerify *v, const struct Matrix *A, const struct Matrix *B, struct Matrix *C, size_t nthreads);
+/* Same as end(), for a B that is not a plain matrix (packed, A^T in SYRK):
+   the caller computes bx = B * x, rounds x A->n, from v->x (C->n each) */
+struct Matrix *matrix_verify_end_bx(struct MatrixVerify *v, const struct Matrix *A, const unsigned *bx, struct Matrix *C, size_t nthreads);
+
+/* Tracing hooks (see matrix_trace_enable). A span is
+       uint64_t t0 = matrix_trace_begin();
+       ...
+       matrix_trace_end("name", t0, arg0, arg1);
+   begin() returns 0 while tracing is off and end() ignores such spans, so
+   a disabled hook costs one relaxed load. name must be a string literal. */
+extern atomic_int matrix_trace_on;
+
+uint64_t matrix_trace_now(void);
+void matrix_trace_end(const char *name, uint64_t t0, size_t arg0, size_t arg1);
+
+static inline uint64_t matrix_trace_begin(void)
+{
+    if (!atomic_load_explicit(&matrix_trace_on, memory_order_relaxed)) return 0;
+    return matrix_trace_now();
+}
+
+#endif /* MATRIX_INTERNAL_H */
@@ -0,0 +1,252 @@
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <unistd.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <stdlib.h>
+
+#include "matrix.h"
+#include "matrix_internal.h"
+
+/* B (k x n) stored as column panels of width block_size.
+   Panel bj holds rows 0..k-1 of columns [bj*bs, bj*bs + w) contiguously,
+   row-major inside the panel, so a (bs x w) tile is one contiguous chunk.
+   The handle is never written after matrix_pack(), so any number of
+   threads may multiply by it concurrently. */
+struct MatrixPacked {
+    size_t k;           /* rows of B */
+    size_t n;           /* cols of B */
+    size_t block_size;  /* panel width and k-block height */
+    size_t bytes;       /* size of data */
+    int *data;
+};
+
+static inline const int *packed_panel(const struct MatrixPacked *P, size_t bj)
+{
+    /* every panel before bj is full width */
+    return P->data + P->k * (bj * P->block_size);
+}
+
+struct MatrixPacked *matrix_pack(const struct Matrix *B, size_t block_size)
+{
+    assert(B && B->arr);
+
+    if (block_size == 0) {
+        block_size = 32;
+    }
+
+    struct MatrixPacked *P = (struct MatrixPacked *)calloc(1, sizeof(struct MatrixPacked));
+    assert(P);
+
+    uint64_t t0 = matrix_trace_begin();
+
+    P->k = B->m;
+    P->n = B->n;
+    P->block_size = block_size;
+
+    /* aligned_alloc wants size to be a multiple of the alignment */
+    size_t bytes = P->k * P->n * sizeof(int);
+    bytes = (bytes + MATRIX_CACHE_LINE - 1) / MATRIX_CACHE_LINE * MATRIX_CACHE_LINE;
+    P->bytes = bytes;
+    P->data = (int *)aligned_alloc(MATRIX_CACHE_LINE, bytes);
+    assert(P->data);
+
+    size_t nbj = (P->n + block_size - 1) / block_size;
+    for (size_t bj = 0; bj < nbj; ++bj) {
+        size_t jj = bj * block_size;
+        size_t w = min_sz(block_size, P->n - jj);
+        int *panel = (int *)packed_panel(P, bj);
+
+        for (size_t k = 0; k < P->k; ++k) {
+            memcpy(panel + k * w, B->arr[k] + jj, w * sizeof(int));
+        }
+    }
+
+    matrix_trace_end("pack", t0, P->k, P->n);
+    return P;
+}
+
+void matrix_packed_dtor(struct MatrixPacked *P)
+{
+    assert(P);
+
+    free(P->data);
+    free(P);
+}
+
+size_t matrix_packed_footprint(const struct MatrixPacked *P)
+{
+    assert(P);
+
+    return sizeof(struct MatrixPacked) + P->bytes;
+}
+
+/* Worker args for multiplication by a packed operand */
+struct PackedMtArg {
+    const struct Matrix *A;
+    const struct MatrixPacked *B;
+    struct Matrix *C;
+    size_t block_row_begin;
+    size_t block_row_end;
+};
+
+/* Worker: compute assigned block-rows [block_row_begin, block_row_end) */
+static void *packed_mt_worker(void *varg)
+{
+    struct PackedMtArg *arg = (struct PackedMtArg *)varg;
+    const struct Matrix *A = arg->A;
+    const struct MatrixPacked *P = arg->B;
+    struct Matrix *C = arg->C;
+    const size_t bs = P->block_size;
+
+    const size_t M = A->m;
+    const size_t K = P->k;
+    const size_t N = P->n;
+
+    size_t nbj = (N + bs - 1) / bs;
+    size_t nbk = (K + bs - 1) / bs;
+
+    for (size_t bi = arg->block_row_begin; bi < arg->block_row_end; ++bi) {
+        size_t ii = bi * bs;
+        size_t i_max = min_sz(ii + bs, M);
+
+        for (size_t bj = 0; bj < nbj; ++bj) {
+            size_t jj = bj * bs;
+            size_t w = min_sz(bs, N - jj);
+            const int *panel = packed_panel(P, bj);
+
+            for (size_t bk = 0; bk < nbk; ++bk) {
+                size_t kk = bk * bs;
+                size_t k_max = min_sz(kk + bs, K);
+
+                /* same i,k,j micro-kernel as the blocked one, but the B tile
+                   is contiguous: row k of the tile is panel[k * w .. k * w + w) */
+                for (size_t i = ii; i < i_max; ++i) {
+                    int *crow = C->arr[i] + jj;
+                    for (size_t k = kk; k < k_max; ++k) {
+                        int aik = A->arr[i][k];
+                        const int *brow = panel + k * w;
+                        for (size_t j = 0; j < w; ++j) {
+                            crow[j] += aik * brow[j];
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    return NULL;
+}
+
+/* bx[r][k] = sum_j B[k][j] * x[r][j] for the verify mode check, read
+   straight from the panels */
+static void packed_matvecs(const struct MatrixPacked *P, const unsigned *x, unsigned *bx, size_t nvec)
+{
+    const size_t bs = P->block_size;
+    size_t nbj = (P->n + bs - 1) / bs;
+
+    for (size_t r = 0; r < nvec; ++r) {
+        const unsigned *xr = x + r * P->n;
+        unsigned *bxr = bx + r * P->k;
+
+        for (size_t bj = 0; bj < nbj; ++bj) {
+            size_t jj = bj * bs;
+            size_t w = min_sz(bs, P->n - jj);
+            const int *panel = packed_panel(P, bj);
+
+            for (size_t k = 0; k < P->k; ++k) {
+                const int *brow = panel + k * w;
+                unsigned sum = 0;
+                for (size_t j = 0; j < w; ++j) {
+                    sum += (unsigned)brow[j] * xr[jj + j];
+                }
+                bxr[k] += sum;
+            }
+        }
+    }
+}
+
+static struct Matrix *packed_verify_end(struct MatrixVerify *v, const struct Matrix *A, const struct MatrixPacked *B, struct Matrix *C, size_t nthreads)
+{
+    if (v->rounds == 0) return C;
+
+    unsigned *bx = (unsigned *)calloc(v->rounds * B->k, sizeof(unsigned));
+    assert(bx);
+    packed_matvecs(B, v->x, bx, v->rounds);
+
+    struct Matrix *result = matrix_verify_end_bx(v, A, bx, C, nthreads);
+
+    free(bx);
+    return result;
+}
+
+/* C += A * B, where B was prepared by matrix_pack() */
+struct Matrix *mul_matrices_packed_pthread(const struct Matrix *A, const struct MatrixPacked *B, struct Matrix *C, size_t nthreads)
+{
+    assert(A && B && C);
+    assert(A->n == B->k && A->m == C->m && B->n == C->n);
+
+    const size_t bs = B->block_size;
+
+    nthreads = detect_threads(nthreads);
+
+    size_t block_rows = (A->m + bs - 1) / bs;
+    if (block_rows == 0) block_rows = 1;
+
+    struct MatrixVerify verify;
+    matrix_verify_begin(&verify, C, 1, 1, nthreads);
+
+    /* quick single-thread fallback (avoid thread overhead for small work) */
+    if (nthreads == 1) {
+        struct PackedMtArg single = { A, B, C, 0, block_rows };
+        packed_mt_worker(&single);
+        return packed_verify_end(&verify, A, B, C, nthreads);
+    }
+
+    pthread_t *threads = (pthread_t *)calloc(nthreads, sizeof(pthread_t));
+    assert(threads);
+    struct PackedMtArg *args = (struct PackedMtArg *)calloc(nthreads, sizeof(struct PackedMtArg));
+    assert(args);
+
+    /* distribute block_rows among threads */
+    size_t base = block_rows / nthreads;
+    size_t rem = block_rows % nthreads;
+    size_t cur_block = 0;
+    for (size_t t = 0; t < nthreads; ++t) {
+        size_t my_blocks = base + (t < rem ? 1 : 0);
+        args[t].A = A;
+        args[t].B = B;
+        args[t].C = C;
+        args[t].block_row_begin = cur_block;
+        args[t].block_row_end = cur_block + my_blocks;
+        cur_block += my_blocks;
+
+        if (args[t].block_row_begin < args[t].block_row_end) {
+            int rc = pthread_create(&threads[t], NULL, packed_mt_worker, &args[t]);
+            if (rc != 0) {
+                /* fallback run in main thread */
+                packed_mt_worker(&args[t]);
+                threads[t] = 0;
+            }
+        } else {
+            threads[t] = 0;
+        }
+    }
+
+    for (size_t t = 0; t < nthreads; ++t) {
+        if (threads[t]) pthread_join(threads[t], NULL);
+    }
+
+    free(threads);
+    free(args);
+    return packed_verify_end(&verify, A, B, C, nthreads);
+}
+
+/* Single-threaded packed wrapper */
+struct Matrix *mul_matrices_packed(const struct Matrix *A, const struct MatrixPacked *B, struct Matrix *C)
+{
+    return mul_matrices_packed_pthread(A, B, C, 1);
+}
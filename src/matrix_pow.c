@@ -0,0 +1,81 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <stdlib.h>
+
+#include "matrix.h"
+
+static void matrix_copy(struct Matrix *dst, const struct Matrix *src)
+{
+    for (size_t i = 0; i < src->m; ++i) {
+        memcpy(dst->arr[i], src->arr[i], src->n * sizeof(int));
+    }
+}
+
+/* dst = X * Y with the blocked parallel kernel; dst is overwritten */
+static struct Matrix *mul_into(struct Matrix *dst, const struct Matrix *X, const struct Matrix *Y, size_t nthreads)
+{
+    matrix_fill(dst, 0);
+    return mul_matrices_blocked_pthread(X, Y, dst, nthreads, 0);
+}
+
+/* A^p by binary exponentiation: O(log p) multiplications instead of p.
+   Works in three n x n buffers allocated once (result, base, scratch);
+   each product goes into scratch, which is then swapped with its target.
+   A itself serves as the first base, so it is never copied. Returns NULL
+   if a multiplication failed verification (see matrix_set_verify). */
+struct Matrix *matrix_pow(const struct Matrix *A, unsigned p, size_t nthreads)
+{
+    assert(A);
+    assert(A->m == A->n);
+
+    const size_t n = A->n;
+
+    if (p == 0) {
+        return matrix_eye(n);
+    }
+
+    struct Matrix *result = NULL;       /* NULL stands for the identity */
+    const struct Matrix *base = A;
+    struct Matrix *base_buf = NULL;
+    struct Matrix *scratch = matrix_ctor(n, n);
+    int ok = 1;
+
+    for (;;) {
+        if (p & 1u) {
+            if (!result) {
+                /* I * base: just copy */
+                result = matrix_ctor(n, n);
+                matrix_copy(result, base);
+            } else {
+                ok = mul_into(scratch, result, base, nthreads) != NULL;
+                struct Matrix *tmp = result;
+                result = scratch;
+                scratch = tmp;
+            }
+        }
+
+        p >>= 1;
+        if (!p || !ok) break;
+
+        if (!base_buf) {
+            base_buf = matrix_ctor(n, n);
+        }
+        ok = mul_into(scratch, base, base, nthreads) != NULL;
+        struct Matrix *tmp = base_buf;
+        base_buf = scratch;
+        scratch = tmp;
+        base = base_buf;
+        if (!ok) break;
+    }
+
+    matrix_dtor(scratch);
+    if (base_buf) matrix_dtor(base_buf);
+    if (!ok) {
+        if (result) matrix_dtor(result);
+        return NULL;
+    }
+    return result;
+}
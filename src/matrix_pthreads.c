@@ -8,6 +8,7 @@
 #include <stdlib.h>
 
 #include "matrix.h"
+#include "matrix_internal.h"
 
 /* ---------------- worker arg ---------------- */
 struct MtArg {
@@ -16,71 +17,117 @@ struct MtArg {
     struct Matrix *C;
     size_t row_begin;   // inclusive
     size_t row_end;     // exclusive
+    size_t col_begin;   // inclusive
+    size_t col_end;     // exclusive
     int order;          // 0 = bad (j,k,i), 1 = cache_friendly (i,j,k), 2 = cache_friendly_most (i,k,j)
+    int alpha;          // C (+)= alpha * A * B
+    uint64_t t_spawn;   // trace: when the launcher created this thread
 };
 
-/* Worker: computes rows [row_begin, row_end) of C */
+/* Worker: computes tile [row_begin, row_end) x [col_begin, col_end) of C */
 static void *mt_worker(void *varg)
 {
     struct MtArg *arg = (struct MtArg *)varg;
     const struct Matrix *A = arg->A;
     const struct Matrix *B = arg->B;
     struct Matrix *C = arg->C;
-    const size_t n = C->n;
     const size_t kdim = A->n;
 
+    matrix_trace_end("thread_start", arg->t_spawn, arg->row_begin, arg->col_begin);
+    uint64_t t0 = matrix_trace_begin();
+
     if (arg->order == 0) {
         /* bad ordering: j,k,i  (as in mul_matrices_bad2) */
-        for (size_t j = 0; j < n; ++j) {
+        for (size_t j = arg->col_begin; j < arg->col_end; ++j) {
             for (size_t k = 0; k < kdim; ++k) {
                 for (size_t i = arg->row_begin; i < arg->row_end; ++i) {
-                    C->arr[i][j] += A->arr[i][k] * B->arr[k][j];
+                    C->arr[i][j] += arg->alpha * A->arr[i][k] * B->arr[k][j];
                 }
             }
         }
     } else if (arg->order == 1) {
         /* cache friendly: i,j,k */
         for (size_t i = arg->row_begin; i < arg->row_end; ++i) {
-            for (size_t j = 0; j < n; ++j) {
+            for (size_t j = arg->col_begin; j < arg->col_end; ++j) {
                 int sum = 0;
                 for (size_t k = 0; k < kdim; ++k) {
                     sum += A->arr[i][k] * B->arr[k][j];
                 }
-                C->arr[i][j] = sum;
+                C->arr[i][j] = arg->alpha * sum;
             }
         }
     } else {
         /* most cache friendly: i,k,j */
         for (size_t i = arg->row_begin; i < arg->row_end; ++i) {
             for (size_t k = 0; k < kdim; ++k) {
-                int aik = A->arr[i][k];
-                for (size_t j = 0; j < n; ++j) {
+                int aik = arg->alpha * A->arr[i][k];
+                for (size_t j = arg->col_begin; j < arg->col_end; ++j) {
                     C->arr[i][j] += aik * B->arr[k][j];
                 }
             }
         }
     }
 
+    matrix_trace_end("mt_tile", t0, arg->row_begin, arg->row_end);
     return NULL;
 }
 
-static struct Matrix *mul_matrices_pthread_generic(const struct Matrix *A, const struct Matrix *B, struct Matrix *C, size_t nthreads, int order)
+/* Pick a prow x pcol thread grid (prow * pcol <= nthreads) for an m x n C.
+   The grid minimizes the largest tile; column chunks are counted in whole
+   cache lines. Ties go to more rows, which keep each thread on whole rows
+   of C. m >= nthreads usually ends up as plain row partitioning, while
+   short-wide shapes (m = 1, m = 8 with huge n) get split by columns. */
+static void choose_grid(size_t m, size_t n, size_t nthreads, size_t *prow, size_t *pcol)
+{
+    size_t lines = (n + COLS_PER_LINE - 1) / COLS_PER_LINE;
+    size_t best_r = 1, best_c = 1;
+    size_t best_cost = (size_t)-1;
+
+    for (size_t r = 1; r <= nthreads && r <= m; ++r) {
+        size_t c = nthreads / r;
+        if (c > lines) c = lines;
+        if (c == 0) c = 1;
+
+        size_t cost = ((m + r - 1) / r) * ((lines + c - 1) / c);
+        if (cost <= best_cost) {
+            best_cost = cost;
+            best_r = r;
+            best_c = c;
+        }
+    }
+
+    *prow = best_r;
+    *pcol = best_c;
+}
+
+static struct Matrix *mul_matrices_pthread_generic(const struct Matrix *A, const struct Matrix *B, struct Matrix *C, size_t nthreads, int order, int alpha)
 {
     assert(A && B);
     assert(A->n == B->m);
 
-    if (nthreads == 0) {
-        long procs = sysconf(_SC_NPROCESSORS_ONLN);
-        if (procs > 0) nthreads = (size_t)procs;
-        else nthreads = 1;
+    nthreads = detect_threads(nthreads);
+
+    size_t prow = 1, pcol = 1;
+    choose_grid(C->m, C->n, nthreads, &prow, &pcol);
+
+    // C too small to keep half of the threads busy, but long K: split K instead
+    // (only for i,k,j, the other orders are kept as reference kernels)
+    if (nthreads > 1 && order == 2 && alpha == 1 && prow * pcol * 2 <= nthreads && A->n >= nthreads * COLS_PER_LINE &&
+        splitk_fits(A, B, nthreads)) {
+        return mul_matrices_splitk_pthread(A, B, C, nthreads, 0);
     }
-    if (nthreads == 0) nthreads = 1;
+
+    // i,j,k overwrites C, the other orders accumulate into it
+    struct MatrixVerify verify;
+    matrix_verify_begin(&verify, C, order != 1, alpha, nthreads);
 
     // If nthreads is 1, fallback to single-threaded kernel (to avoid thread overhead)
     if (nthreads == 1) {
-        struct MtArg arg = { A, B, C, 0, C->m, order };
+        struct MtArg arg = { .A = A, .B = B, .C = C,
+                             .row_begin = 0, .row_end = C->m, .col_begin = 0, .col_end = C->n,
+                             .order = order, .alpha = alpha };
         mt_worker(&arg);
-        return C;
+        return matrix_verify_end(&verify, A, B, C, nthreads);
     }
 
     pthread_t *threads = (pthread_t *)calloc(nthreads, sizeof(pthread_t));
@@ -88,44 +135,64 @@ static struct Matrix *mul_matrices_pthread_generic(const struct Matrix *A, const
     struct MtArg *args = (struct MtArg *)calloc(nthreads, sizeof(struct MtArg));
     assert(args);
 
-    // Partition rows as evenly as possible
+    // Partition rows as evenly as possible, columns in whole cache lines
     size_t rows = C->m;
-    size_t base = rows / nthreads;
-    size_t rem = rows % nthreads;
-    size_t cur = 0;
-
-    for (size_t t = 0; t < nthreads; ++t) {
-        size_t chunk = base + (t < rem ? 1 : 0);
-        args[t].A = A;
-        args[t].B = B;
-        args[t].C = C;
-        args[t].row_begin = cur;
-        args[t].row_end = cur + chunk;
-        args[t].order = order;
-        cur += chunk;
-        // create thread only if it has non-empty range
-        if (args[t].row_begin < args[t].row_end) {
-            int rc = pthread_create(&threads[t], NULL, mt_worker, &args[t]);
-            if (rc != 0) {
-                // fallback: run in main thread if create failed
-                mt_worker(&args[t]);
-                threads[t] = 0; // mark as not created
+    size_t rbase = rows / prow;
+    size_t rrem = rows % prow;
+    size_t lines = (C->n + COLS_PER_LINE - 1) / COLS_PER_LINE;
+    size_t cbase = lines / pcol;
+    size_t crem = lines % pcol;
+
+    uint64_t t_create = matrix_trace_begin();
+    size_t t = 0;
+    size_t rcur = 0;
+    for (size_t r = 0; r < prow; ++r) {
+        size_t rchunk = rbase + (r < rrem ? 1 : 0);
+        size_t ccur = 0;
+        for (size_t c = 0; c < pcol; ++c, ++t) {
+            size_t cchunk = cbase + (c < crem ? 1 : 0);
+            args[t].A = A;
+            args[t].B = B;
+            args[t].C = C;
+            args[t].row_begin = rcur;
+            args[t].row_end = rcur + rchunk;
+            args[t].col_begin = ccur * COLS_PER_LINE;
+            args[t].col_end = (ccur + cchunk) * COLS_PER_LINE;
+            if (args[t].col_begin > C->n) args[t].col_begin = C->n;
+            if (args[t].col_end > C->n) args[t].col_end = C->n;
+            args[t].order = order;
+            args[t].alpha = alpha;
+            ccur += cchunk;
+            // create thread only if it has non-empty tile
+            if (args[t].row_begin < args[t].row_end && args[t].col_begin < args[t].col_end) {
+                args[t].t_spawn = matrix_trace_begin();
+                int rc = pthread_create(&threads[t], NULL, mt_worker, &args[t]);
+                if (rc != 0) {
+                    // fallback: run in main thread if create failed
+                    mt_worker(&args[t]);
+                    threads[t] = 0; // mark as not created
+                }
+            } else {
+                threads[t] = 0;
             }
-        } else {
-            threads[t] = 0;
         }
+        rcur += rchunk;
     }
 
-    // join threads
-    for (size_t t = 0; t < nthreads; ++t) {
+    matrix_trace_end("mt_create", t_create, prow, pcol);
+
+    // join threads (slots past prow * pcol were never used)
+    uint64_t t_join = matrix_trace_begin();
+    for (t = 0; t < nthreads; ++t) {
         if (threads[t]) {
             pthread_join(threads[t], NULL);
         }
     }
+    matrix_trace_end("mt_join", t_join, prow, pcol);
 
     free(threads);
     free(args);
-    return C;
+    return matrix_verify_end(&verify, A, B, C, nthreads);
 }
 
 /* Public wrappers */
@@ -133,23 +200,29 @@ static struct Matrix *mul_matrices_pthread_generic(const struct Matrix *A, const
 /* Generic: default order most cache-friendly (i,k,j) */
 struct Matrix *mul_matrices_pthread(const struct Matrix *A, const struct Matrix *B, struct Matrix *C, size_t nthreads)
 {
-    return mul_matrices_pthread_generic(A, B, C, nthreads, 2);
+    return mul_matrices_pthread_generic(A, B, C, nthreads, 2, 1);
 }
 
 /* Bad ordering parallel (j,k,i) */
 struct Matrix *mul_matrices_bad_mt(const struct Matrix *A, const struct Matrix *B, struct Matrix *C, size_t nthreads)
 {
-    return mul_matrices_pthread_generic(A, B, C, nthreads, 0);
+    return mul_matrices_pthread_generic(A, B, C, nthreads, 0, 1);
 }
 
 /* i,j,k ordering parallel */
 struct Matrix *mul_matrices_cache_friendly_mt(const struct Matrix *A, const struct Matrix *B, struct Matrix *C, size_t nthreads)
 {
-    return mul_matrices_pthread_generic(A, B, C, nthreads, 1);
+    return mul_matrices_pthread_generic(A, B, C, nthreads, 1, 1);
 }
 
 /* i,k,j ordering parallel (most cache-friendly) */
 struct Matrix *mul_matrices_cache_friendly_most_mt(const struct Matrix *A, const struct Matrix *B, struct Matrix *C, size_t nthreads)
 {
-    return mul_matrices_pthread_generic(A, B, C, nthreads, 2);
+    return mul_matrices_pthread_generic(A, B, C, nthreads, 2, 1);
+}
+
+/* C += alpha * A * B, i,k,j ordering parallel; alpha is folded into A[i][k] */
+struct Matrix *mul_matrices_scaled_mt(const struct Matrix *A, const struct Matrix *B, struct Matrix *C, int alpha, size_t nthreads)
+{
+    return mul_matrices_pthread_generic(A, B, C, nthreads, 2, alpha);
 }
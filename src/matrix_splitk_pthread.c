@@ -0,0 +1,232 @@
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <unistd.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <stdlib.h>
+
+#include "matrix.h"
+#include "matrix_internal.h"
+
+/* State shared by all split-K participants.
+   Participant 0 accumulates straight into C, every other one into a private
+   zeroed m x n buffer; the buffers are then folded pairwise into C. */
+struct SplitKShared {
+    const struct Matrix *A;
+    const struct Matrix *B;
+    size_t block_size;
+    size_t nparts;      /* participants, known only after thread creation */
+    int ***targets;     /* targets[p] = rows of the partial C of participant p */
+
+    pthread_barrier_t barrier;
+    pthread_mutex_t lock;
+    pthread_cond_t go_cond;
+    int go;
+};
+
+struct SplitKArg {
+    struct SplitKShared *sh;
+    size_t id;
+};
+
+/* dst[e] += src[e] for the flattened element range [e_begin, e_end) of an m x n matrix */
+static void add_range(int **dst, int **src, size_t n, size_t e_begin, size_t e_end)
+{
+    while (e_begin < e_end) {
+        size_t i = e_begin / n;
+        size_t j = e_begin % n;
+        size_t j_max = min_sz(n, j + (e_end - e_begin));
+
+        int *d = dst[i];
+        const int *s = src[i];
+        for (size_t jj = j; jj < j_max; ++jj) {
+            d[jj] += s[jj];
+        }
+        e_begin += j_max - j;
+    }
+}
+
+/* partial C over k in [k_begin, k_end), blocked i,k,j as in block_mt_worker */
+static void splitk_partial(const struct Matrix *A, const struct Matrix *B, int **C, size_t bs, size_t k_begin, size_t k_end)
+{
+    const size_t M = A->m;
+    const size_t N = B->n;
+
+    for (size_t ii = 0; ii < M; ii += bs) {
+        size_t i_max = min_sz(ii + bs, M);
+
+        for (size_t jj = 0; jj < N; jj += bs) {
+            size_t j_max = min_sz(jj + bs, N);
+
+            for (size_t kk = k_begin; kk < k_end; kk += bs) {
+                size_t k_max = min_sz(kk + bs, k_end);
+
+                for (size_t i = ii; i < i_max; ++i) {
+                    for (size_t k = kk; k < k_max; ++k) {
+                        int aik = A->arr[i][k];
+                        for (size_t j = jj; j < j_max; ++j) {
+                            C[i][j] += aik * B->arr[k][j];
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+static void *splitk_worker(void *varg)
+{
+    struct SplitKArg *arg = (struct SplitKArg *)varg;
+    struct SplitKShared *sh = arg->sh;
+    const size_t id = arg->id;
+
+    /* wait until the final number of participants is known */
+    pthread_mutex_lock(&sh->lock);
+    while (!sh->go) {
+        pthread_cond_wait(&sh->go_cond, &sh->lock);
+    }
+    pthread_mutex_unlock(&sh->lock);
+
+    const size_t P = sh->nparts;
+    const size_t M = sh->A->m;
+    const size_t K = sh->A->n;
+    const size_t N = sh->B->n;
+
+    /* split K as evenly as possible */
+    size_t base = K / P;
+    size_t rem = K % P;
+    size_t k_begin = id * base + min_sz(id, rem);
+    size_t k_end = k_begin + base + (id < rem ? 1 : 0);
+
+    uint64_t t0 = matrix_trace_begin();
+    splitk_partial(sh->A, sh->B, sh->targets[id], sh->block_size, k_begin, k_end);
+    matrix_trace_end("splitk_partial", t0, k_begin, k_end);
+
+    /* tree reduction: in round s the group [g, g + 2s) folds targets[g + s]
+       into targets[g], and all threads of the group share the elements */
+    const size_t total = M * N;
+    for (size_t s = 1; s < P; s *= 2) {
+        uint64_t t_wait = matrix_trace_begin();
+        pthread_barrier_wait(&sh->barrier);
+        matrix_trace_end("splitk_barrier", t_wait, s, 0);
+
+        size_t g = id / (2 * s) * (2 * s);
+        if (g + s >= P) continue;
+
+        size_t gsize = min_sz(2 * s, P - g);
+        size_t me = id - g;
+        size_t e_base = total / gsize;
+        size_t e_rem = total % gsize;
+        size_t e_begin = me * e_base + min_sz(me, e_rem);
+        size_t e_end = e_begin + e_base + (me < e_rem ? 1 : 0);
+
+        uint64_t t_add = matrix_trace_begin();
+        add_range(sh->targets[g], sh->targets[g + s], N, e_begin, e_end);
+        matrix_trace_end("splitk_reduce", t_add, s, e_end - e_begin);
+    }
+
+    return NULL;
+}
+
+/* C += A * B with the inner dimension split among threads.
+   Meant for small m x n and huge k (Gram-like products), where row or column
+   partitioning of C leaves most threads idle. Needs (nthreads - 1) * m * n
+   extra ints for the partial results. */
+struct Matrix *mul_matrices_splitk_pthread(const struct Matrix *A, const struct Matrix *B, struct Matrix *C, size_t nthreads, size_t block_size)
+{
+    assert(A && B && C);
+    assert(A->n == B->m && A->m == C->m && B->n == C->n);
+
+    if (block_size == 0) {
+        block_size = 32;
+    }
+
+    nthreads = detect_threads(nthreads);
+    if (nthreads > A->n) nthreads = A->n;
+    if (nthreads == 0) nthreads = 1;
+
+    struct MatrixVerify verify;
+    matrix_verify_begin(&verify, C, 1, 1, nthreads);
+
+    if (nthreads == 1) {
+        splitk_partial(A, B, C->arr, block_size, 0, A->n);
+        return matrix_verify_end(&verify, A, B, C, nthreads);
+    }
+
+    struct SplitKShared sh;
+    memset(&sh, 0, sizeof(sh));
+    sh.A = A;
+    sh.B = B;
+    sh.block_size = block_size;
+    pthread_mutex_init(&sh.lock, NULL);
+    pthread_cond_init(&sh.go_cond, NULL);
+
+    pthread_t *threads = (pthread_t *)calloc(nthreads, sizeof(pthread_t));
+    assert(threads);
+    struct SplitKArg *args = (struct SplitKArg *)calloc(nthreads, sizeof(struct SplitKArg));
+    assert(args);
+
+    /* participant 0 is the calling thread; stop at the first failed create
+       and run with whoever has been started */
+    size_t nparts = 1;
+    args[0].sh = &sh;
+    args[0].id = 0;
+    for (size_t t = 1; t < nthreads; ++t) {
+        args[t].sh = &sh;
+        args[t].id = t;
+        if (pthread_create(&threads[t], NULL, splitk_worker, &args[t]) != 0) {
+            break;
+        }
+        ++nparts;
+    }
+
+    const size_t M = C->m;
+    const size_t N = C->n;
+
+    int ***targets = (int ***)calloc(nparts, sizeof(int **));
+    assert(targets);
+    int *partials = NULL;
+    targets[0] = C->arr;
+    if (nparts > 1) {
+        partials = (int *)calloc((nparts - 1) * M * N, sizeof(int));
+        assert(partials);
+        for (size_t p = 1; p < nparts; ++p) {
+            targets[p] = (int **)calloc(M, sizeof(int *));
+            assert(targets[p]);
+            for (size_t i = 0; i < M; ++i) {
+                targets[p][i] = partials + ((p - 1) * M + i) * N;
+            }
+        }
+    }
+
+    sh.nparts = nparts;
+    sh.targets = targets;
+    pthread_barrier_init(&sh.barrier, NULL, (unsigned)nparts);
+
+    pthread_mutex_lock(&sh.lock);
+    sh.go = 1;
+    pthread_cond_broadcast(&sh.go_cond);
+    pthread_mutex_unlock(&sh.lock);
+
+    splitk_worker(&args[0]);
+
+    for (size_t t = 1; t < nparts; ++t) {
+        pthread_join(threads[t], NULL);
+    }
+
+    pthread_barrier_destroy(&sh.barrier);
+    pthread_cond_destroy(&sh.go_cond);
+    pthread_mutex_destroy(&sh.lock);
+
+    for (size_t p = 1; p < nparts; ++p) {
+        free(targets[p]);
+    }
+    free(targets);
+    free(partials);
+    free(threads);
+    free(args);
+    return matrix_verify_end(&verify, A, B, C, nthreads);
+}
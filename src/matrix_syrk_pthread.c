@@ -0,0 +1,187 @@
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <unistd.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+
+#include "matrix.h"
+#include "matrix_internal.h"
+
+/* One tile of the lower triangle of C: block-row p, block-col q, q <= p */
+struct SyrkTile {
+    size_t p;
+    size_t q;
+};
+
+struct SyrkShared {
+    const struct Matrix *A;
+    struct Matrix *C;
+    enum MatrixUplo uplo;
+    int mirror;
+    size_t block_size;
+    const struct SyrkTile *tiles;
+    size_t ntiles;
+    atomic_size_t next;  /* first tile nobody has taken yet */
+};
+
+/* C[i][j] += dot(A[i], A[j]) for i in block p, j in block q, j <= i.
+   With uplo == MATRIX_UPPER the value goes to C[j][i] instead, so both
+   triangles are produced from the same (cheaper to enumerate) lower tiles. */
+static void syrk_tile(const struct SyrkShared *sh, size_t p, size_t q)
+{
+    const struct Matrix *A = sh->A;
+    int **C = sh->C->arr;
+    const size_t bs = sh->block_size;
+    const size_t M = A->m;
+    const size_t K = A->n;
+
+    size_t ii = p * bs;
+    size_t i_max = min_sz(ii + bs, M);
+    size_t jj = q * bs;
+    size_t j_max = min_sz(jj + bs, M);
+    const int lower = sh->uplo == MATRIX_LOWER;
+
+    /* both operands are rows of A, so the k loop is contiguous for each;
+       k is blocked to keep the 2 * bs rows of the tile in cache */
+    for (size_t kk = 0; kk < K; kk += bs) {
+        size_t k_max = min_sz(kk + bs, K);
+
+        for (size_t i = ii; i < i_max; ++i) {
+            const int *ai = A->arr[i];
+            size_t j_end = (p == q) ? i + 1 : j_max;
+
+            for (size_t j = jj; j < j_end; ++j) {
+                const int *aj = A->arr[j];
+                int sum = 0;
+                for (size_t k = kk; k < k_max; ++k) {
+                    sum += ai[k] * aj[k];
+                }
+                if (lower) C[i][j] += sum;
+                else       C[j][i] += sum;
+            }
+        }
+    }
+
+    if (!sh->mirror) return;
+
+    /* the transposed tile belongs to nobody else, so no sync is needed */
+    for (size_t i = ii; i < i_max; ++i) {
+        size_t j_end = (p == q) ? i : j_max;
+        for (size_t j = jj; j < j_end; ++j) {
+            if (lower) C[j][i] = C[i][j];
+            else       C[i][j] = C[j][i];
+        }
+    }
+}
+
+/* Worker: grab tiles until none are left. Diagonal tiles cost half of the
+   others, dynamic scheduling evens that out. */
+static void *syrk_worker(void *varg)
+{
+    struct SyrkShared *sh = (struct SyrkShared *)varg;
+
+    for (;;) {
+        size_t t = atomic_fetch_add_explicit(&sh->next, 1, memory_order_relaxed);
+        if (t >= sh->ntiles) break;
+        syrk_tile(sh, sh->tiles[t].p, sh->tiles[t].q);
+    }
+
+    return NULL;
+}
+
+/* bx[r][k] = sum_i A[i][k] * x[r][i], i.e. A^T * x, for the verify mode check */
+static void syrk_matvecs_t(const struct Matrix *A, const unsigned *x, unsigned *bx, size_t nvec)
+{
+    for (size_t r = 0; r < nvec; ++r) {
+        const unsigned *xr = x + r * A->m;
+        unsigned *bxr = bx + r * A->n;
+
+        for (size_t i = 0; i < A->m; ++i) {
+            const int *row = A->arr[i];
+            unsigned xi = xr[i];
+            if (xi == 0) continue;
+            for (size_t k = 0; k < A->n; ++k) {
+                bxr[k] += xi * (unsigned)row[k];
+            }
+        }
+    }
+}
+
+/* C += A * A^T (m x m) without forming A^T; only the uplo triangle
+   (diagonal included) is computed. With mirror != 0 the other triangle is
+   then overwritten with the transposed values, giving the full product if
+   C was symmetric (e.g. zero) on entry. In verify mode only mirrored
+   results are checked (against C + A * A^T, so C must be symmetric on
+   entry): a single triangle is not a product. */
+struct Matrix *mul_matrices_syrk_pthread(const struct Matrix *A, struct Matrix *C, enum MatrixUplo uplo, int mirror, size_t nthreads, size_t block_size)
+{
+    assert(A && C);
+    assert(C->m == A->m && C->n == A->m);
+    assert(uplo == MATRIX_UPPER || uplo == MATRIX_LOWER);
+
+    if (block_size == 0) {
+        block_size = 32;
+    }
+
+    nthreads = detect_threads(nthreads);
+
+    size_t nb = (A->m + block_size - 1) / block_size;
+    size_t ntiles = nb * (nb + 1) / 2;
+    if (nthreads > ntiles) nthreads = ntiles;
+
+    struct SyrkTile *tiles = (struct SyrkTile *)calloc(ntiles, sizeof(struct SyrkTile));
+    assert(tiles);
+    size_t cur = 0;
+    for (size_t p = 0; p < nb; ++p) {
+        for (size_t q = 0; q <= p; ++q) {
+            tiles[cur].p = p;
+            tiles[cur].q = q;
+            ++cur;
+        }
+    }
+
+    struct MatrixVerify verify = { 0 };
+    if (mirror) {
+        matrix_verify_begin(&verify, C, 1, 1, nthreads);
+    }
+
+    struct SyrkShared sh = { A, C, uplo, mirror, block_size, tiles, ntiles, 0 };
+    atomic_init(&sh.next, 0);
+
+    /* the calling thread takes tiles too, so a failed create only costs speed */
+    pthread_t *threads = (pthread_t *)calloc(nthreads, sizeof(pthread_t));
+    assert(threads);
+    for (size_t t = 1; t < nthreads; ++t) {
+        if (pthread_create(&threads[t], NULL, syrk_worker, &sh) != 0) {
+            threads[t] = 0;
+        }
+    }
+
+    syrk_worker(&sh);
+
+    for (size_t t = 1; t < nthreads; ++t) {
+        if (threads[t]) pthread_join(threads[t], NULL);
+    }
+
+    free(threads);
+    free(tiles);
+
+    if (verify.rounds == 0) return C;
+
+    unsigned *bx = (unsigned *)calloc(verify.rounds * A->n, sizeof(unsigned));
+    assert(bx);
+    syrk_matvecs_t(A, verify.x, bx, verify.rounds);
+    struct Matrix *result = matrix_verify_end_bx(&verify, A, bx, C, nthreads);
+    free(bx);
+    return result;
+}
+
+/* Single-threaded SYRK wrapper */
+struct Matrix *mul_matrices_syrk(const struct Matrix *A, struct Matrix *C, enum MatrixUplo uplo, int mirror, size_t block_size)
+{
+    return mul_matrices_syrk_pthread(A, C, uplo, mirror, 1, block_size);
+}
@@ -0,0 +1,193 @@
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "matrix.h"
+#include "matrix_internal.h"
+
+/* Execution timeline tracing.
+
+   Every thread that records a span owns a ring buffer of the last
+   `capacity` spans; only the owner writes it, so recording needs no locks.
+   Rings live in a global list that only grows (lock-free push). When a
+   thread exits its ring is marked free and the next new thread adopts it,
+   so the short-lived workers of every multiplication do not pile up rings.
+   Each span keeps the tid of the thread that recorded it. */
+
+#define TRACE_DEFAULT_EVENTS 4096
+
+struct TraceEvent {
+    const char *name;
+    uint64_t ts;        /* ns, matrix_trace_now() */
+    uint64_t dur;       /* ns */
+    uint32_t tid;
+    size_t arg0;
+    size_t arg1;
+};
+
+struct TraceRing {
+    struct TraceRing *next;
+    atomic_int in_use;
+    atomic_size_t head;         /* spans ever written; slot = head % capacity */
+    size_t capacity;
+    struct TraceEvent *events;
+};
+
+atomic_int matrix_trace_on;
+
+static atomic_size_t trace_capacity = TRACE_DEFAULT_EVENTS;
+static _Atomic(struct TraceRing *) trace_rings;
+static _Atomic uint64_t trace_epoch;
+
+static _Thread_local struct TraceRing *my_ring;
+static _Thread_local uint32_t my_tid;
+
+static pthread_once_t ring_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t ring_key;
+
+uint64_t matrix_trace_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    /* never 0: that value means "tracing was off" */
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec + 1;
+}
+
+static void ring_release(void *ring)
+{
+    atomic_store_explicit(&((struct TraceRing *)ring)->in_use, 0, memory_order_release);
+}
+
+static void ring_key_create(void)
+{
+    pthread_key_create(&ring_key, ring_release);
+}
+
+static struct TraceRing *ring_acquire(void)
+{
+    pthread_once(&ring_key_once, ring_key_create);
+
+    struct TraceRing *ring = NULL;
+    for (struct TraceRing *r = atomic_load(&trace_rings); r; r = r->next) {
+        int expected = 0;
+        if (atomic_compare_exchange_strong(&r->in_use, &expected, 1)) {
+            ring = r;
+            break;
+        }
+    }
+
+    if (!ring) {
+        ring = (struct TraceRing *)calloc(1, sizeof(struct TraceRing));
+        assert(ring);
+        ring->capacity = atomic_load(&trace_capacity);
+        ring->events = (struct TraceEvent *)calloc(ring->capacity, sizeof(struct TraceEvent));
+        assert(ring->events);
+        atomic_init(&ring->in_use, 1);
+        atomic_init(&ring->head, 0);
+
+        struct TraceRing *head = atomic_load(&trace_rings);
+        do {
+            ring->next = head;
+        } while (!atomic_compare_exchange_weak(&trace_rings, &head, ring));
+    }
+
+    pthread_setspecific(ring_key, ring);
+    my_tid = (uint32_t)syscall(SYS_gettid);
+    return ring;
+}
+
+void matrix_trace_end(const char *name, uint64_t t0, size_t arg0, size_t arg1)
+{
+    if (t0 == 0) return;
+
+    uint64_t t1 = matrix_trace_now();
+    struct TraceRing *ring = my_ring;
+    if (!ring) {
+        ring = my_ring = ring_acquire();
+    }
+
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    struct TraceEvent *ev = &ring->events[head % ring->capacity];
+    ev->name = name;
+    ev->ts = t0;
+    ev->dur = t1 - t0;
+    ev->tid = my_tid;
+    ev->arg0 = arg0;
+    ev->arg1 = arg1;
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+/* Starts recording, dropping spans of an earlier session. Every ring keeps
+   the last events_per_thread spans (0 -> default); rings of another size
+   are reallocated, which is why no multiplication may be running. */
+void matrix_trace_enable(size_t events_per_thread)
+{
+    size_t capacity = events_per_thread ? events_per_thread : TRACE_DEFAULT_EVENTS;
+    atomic_store(&trace_capacity, capacity);
+
+    for (struct TraceRing *r = atomic_load(&trace_rings); r; r = r->next) {
+        if (r->capacity != capacity) {
+            free(r->events);
+            r->events = (struct TraceEvent *)calloc(capacity, sizeof(struct TraceEvent));
+            assert(r->events);
+            r->capacity = capacity;
+        }
+        atomic_store(&r->head, 0);
+    }
+    atomic_store(&trace_epoch, matrix_trace_now());
+    atomic_store(&matrix_trace_on, 1);
+}
+
+void matrix_trace_disable(void)
+{
+    atomic_store(&matrix_trace_on, 0);
+}
+
+/* Writes all recorded spans in Chrome trace-event format (complete "X"
+   events, microseconds from matrix_trace_enable), which chrome://tracing
+   and Perfetto open directly. Call it while no multiplication is running.
+   Returns 0 on success. */
+int matrix_trace_dump(const char *path)
+{
+    assert(path);
+
+    FILE *fout = fopen(path, "w");
+    if (!fout) {
+        perror("fopen");
+        return -1;
+    }
+
+    const uint64_t epoch = atomic_load(&trace_epoch);
+    const long pid = (long)getpid();
+    int first = 1;
+
+    fprintf(fout, "{\"traceEvents\":[\n");
+    for (struct TraceRing *r = atomic_load(&trace_rings); r; r = r->next) {
+        size_t head = atomic_load_explicit(&r->head, memory_order_acquire);
+        size_t count = head < r->capacity ? head : r->capacity;
+
+        for (size_t i = head - count; i < head; ++i) {
+            const struct TraceEvent *ev = &r->events[i % r->capacity];
+            if (ev->ts < epoch) continue;
+
+            fprintf(fout, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%ld,\"tid\":%u,"
+                          "\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"a0\":%zu,\"a1\":%zu}}",
+                    first ? "" : ",\n", ev->name, pid, ev->tid,
+                    (double)(ev->ts - epoch) / 1e3, (double)ev->dur / 1e3, ev->arg0, ev->arg1);
+            first = 0;
+        }
+    }
+    fprintf(fout, "\n],\"displayTimeUnit\":\"ns\"}\n");
+
+    int rc = ferror(fout) ? -1 : 0;
+    if (fclose(fout) != 0) rc = -1;
+    return rc;
+}
@@ -0,0 +1,305 @@
+#define _GNU_SOURCE
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <stdlib.h>
+
+#include "matrix.h"
+
+/* Local transport for ranks forked on one Linux box.
+
+   Payload goes through one POSIX shared memory segment holding one slot
+   of max_msg bytes per rank: a rank writes what it sends into its own
+   slot and the receivers copy it out from there, so a broadcast writes the
+   payload once however many ranks read it. The segment is nranks *
+   max_msg bytes, about the size of the largest matrix for SUMMA.
+
+   Every rank has one datagram socketpair for incoming notifications: it
+   reads one end, all the others write the other end. A notification is
+   the sender's rank plus MSG_DATA ("my slot holds a message for you") or
+   MSG_ACK ("I copied it out"). A rank rewrites its slot only once every
+   reader of the previous message has acked, so send() blocks until the
+   previous message of this rank, to whichever peer, has been received.
+
+   A shared endpoint never reports a dead writer, so every rank also holds
+   the only write end of a pipe whose read end the others poll: it hangs
+   up when the rank exits. That is 4 descriptors per rank in the launcher
+   until the ranks are started, and 2 per rank after attach. */
+
+#define MSG_DATA 'D'
+#define MSG_ACK  'A'
+
+struct ShmNote {
+    uint32_t src;
+    unsigned char msg;
+};
+
+struct ShmTransport {
+    size_t nranks;
+    size_t max_msg;
+    size_t rank;            /* valid after attach */
+    unsigned char *mem;     /* nranks slots */
+    size_t mem_size;
+    int *note_rx;           /* per rank, the end it reads notifications from */
+    int *note_tx;           /* per rank, the end the others notify it through */
+    int *alive_rd;          /* per rank, hangs up once the rank has exited */
+    int *alive_wr;          /* per rank, held by that rank only after attach */
+    size_t *readers;        /* per peer, 1 while it has not acked my slot yet */
+    size_t *pending;        /* per peer, messages waiting in its slot for me */
+};
+
+static inline unsigned char *slot(struct ShmTransport *s, size_t rank)
+{
+    return s->mem + rank * s->max_msg;
+}
+
+static int shm_open_transport(struct MatrixTransport *t, size_t nranks, size_t max_msg)
+{
+    static atomic_uint segments;
+
+    struct ShmTransport *s = (struct ShmTransport *)calloc(1, sizeof(struct ShmTransport));
+    assert(s);
+    s->nranks = nranks;
+    s->max_msg = max_msg ? max_msg : 1;
+    s->mem_size = nranks * s->max_msg;
+
+    char name[64];
+    snprintf(name, sizeof(name), "/matrix_dist_%ld_%u", (long)getpid(), atomic_fetch_add(&segments, 1));
+
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0) {
+        free(s);
+        return -1;
+    }
+    /* the mapping survives the name; nothing is left behind on a crash */
+    shm_unlink(name);
+
+    if (ftruncate(fd, (off_t)s->mem_size) != 0) {
+        close(fd);
+        free(s);
+        return -1;
+    }
+    s->mem = (unsigned char *)mmap(NULL, s->mem_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (s->mem == MAP_FAILED) {
+        free(s);
+        return -1;
+    }
+
+    s->note_rx = (int *)malloc(nranks * sizeof(int));
+    s->note_tx = (int *)malloc(nranks * sizeof(int));
+    s->alive_rd = (int *)malloc(nranks * sizeof(int));
+    s->alive_wr = (int *)malloc(nranks * sizeof(int));
+    s->readers = (size_t *)calloc(nranks, sizeof(size_t));
+    s->pending = (size_t *)calloc(nranks, sizeof(size_t));
+    assert(s->note_rx && s->note_tx && s->alive_rd && s->alive_wr && s->readers && s->pending);
+
+    for (size_t r = 0; r < nranks; ++r) {
+        s->note_rx[r] = s->note_tx[r] = s->alive_rd[r] = s->alive_wr[r] = -1;
+    }
+    t->impl = s;
+    for (size_t r = 0; r < nranks; ++r) {
+        int sv[2], pv[2];
+        if (socketpair(AF_UNIX, SOCK_DGRAM, 0, sv) != 0) {
+            t->close(t);
+            return -1;
+        }
+        s->note_rx[r] = sv[0];
+        s->note_tx[r] = sv[1];
+        if (pipe(pv) != 0) {
+            t->close(t);
+            return -1;
+        }
+        s->alive_rd[r] = pv[0];
+        s->alive_wr[r] = pv[1];
+    }
+
+    return 0;
+}
+
+static void close_fd(int *fd)
+{
+    if (*fd >= 0) {
+        close(*fd);
+        *fd = -1;
+    }
+}
+
+/* Keeps the notification ends towards every rank, our own inbox and
+   liveness pipe, and the liveness ends of the others */
+static int shm_attach(struct MatrixTransport *t, size_t rank)
+{
+    struct ShmTransport *s = (struct ShmTransport *)t->impl;
+    assert(s && rank < s->nranks);
+
+    s->rank = rank;
+    for (size_t r = 0; r < s->nranks; ++r) {
+        if (r == rank) {
+            close_fd(&s->alive_rd[r]);
+        } else {
+            close_fd(&s->note_rx[r]);
+            close_fd(&s->alive_wr[r]);
+        }
+    }
+    for (size_t p = 0; p < s->nranks; ++p) {
+        s->readers[p] = 0;
+        s->pending[p] = 0;
+    }
+    return 0;
+}
+
+/* Reads one notification, from whichever peer, and books it */
+static int shm_read_note(struct ShmTransport *s)
+{
+    struct ShmNote note;
+    ssize_t rc;
+
+    do {
+        rc = recv(s->note_rx[s->rank], &note, sizeof(note), 0);
+    } while (rc < 0 && errno == EINTR);
+    if (rc != (ssize_t)sizeof(note) || note.src >= s->nranks || note.src == s->rank) return -1;
+
+    if (note.msg == MSG_DATA) ++s->pending[note.src];
+    else if (note.msg == MSG_ACK && s->readers[note.src] > 0) --s->readers[note.src];
+    else return -1;
+    return 0;
+}
+
+/* Books the next notification; fails once peer, the one we are waiting
+   for, has exited without leaving one (it is queued before the exit) */
+static int shm_pump(struct ShmTransport *s, size_t peer)
+{
+    struct pollfd pf[2] = {
+        { s->note_rx[s->rank], POLLIN, 0 },
+        { s->alive_rd[peer], POLLIN, 0 },
+    };
+
+    for (;;) {
+        if (poll(pf, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        if (pf[0].revents & POLLIN) return shm_read_note(s);
+        if (pf[1].revents) return -1;
+    }
+}
+
+static int shm_notify(struct ShmTransport *s, size_t peer, unsigned char msg)
+{
+    struct ShmNote note;
+    memset(&note, 0, sizeof(note));
+    note.src = (uint32_t)s->rank;
+    note.msg = msg;
+
+    for (;;) {
+        ssize_t rc = send(s->note_tx[peer], &note, sizeof(note), MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (rc == (ssize_t)sizeof(note)) return 0;
+        if (rc >= 0 || (errno != EINTR && errno != EAGAIN && errno != EWOULDBLOCK)) return -1;
+        if (errno == EINTR) continue;
+
+        /* the endpoint is full: keep reading ours meanwhile, or two ranks
+           notifying each other could wait for each other forever */
+        struct pollfd pf[2] = {
+            { s->note_tx[peer], POLLOUT, 0 },
+            { s->note_rx[s->rank], POLLIN, 0 },
+        };
+        if (poll(pf, 2, -1) < 0 && errno != EINTR) return -1;
+        if ((pf[1].revents & POLLIN) && shm_read_note(s) != 0) return -1;
+    }
+}
+
+/* Waits until every reader of the previous message has acked our slot */
+static int shm_slot_wait(struct ShmTransport *s)
+{
+    for (size_t p = 0; p < s->nranks; ++p) {
+        while (s->readers[p] > 0) {
+            if (shm_pump(s, p) != 0) return -1;
+        }
+    }
+    return 0;
+}
+
+static int shm_send(struct MatrixTransport *t, size_t dst, const void *buf, size_t len)
+{
+    struct ShmTransport *s = (struct ShmTransport *)t->impl;
+    assert(dst < s->nranks && dst != s->rank && len <= s->max_msg);
+
+    if (shm_slot_wait(s) != 0) return -1;
+    memcpy(slot(s, s->rank), buf, len);
+    s->readers[dst] = 1;
+    return shm_notify(s, dst, MSG_DATA);
+}
+
+static int shm_recv(struct MatrixTransport *t, size_t src, void *buf, size_t len)
+{
+    struct ShmTransport *s = (struct ShmTransport *)t->impl;
+    assert(src < s->nranks && src != s->rank && len <= s->max_msg);
+
+    while (s->pending[src] == 0) {
+        if (shm_pump(s, src) != 0) return -1;
+    }
+    memcpy(buf, slot(s, src), len);
+    --s->pending[src];
+    /* the payload is ours already; a sender that has exited since (e.g.
+       after its last message) does not need the ack */
+    shm_notify(s, src, MSG_ACK);
+    return 0;
+}
+
+/* The root writes its slot once and notifies every other member */
+static int shm_bcast(struct MatrixTransport *t, size_t root, const size_t *ranks, size_t nranks, void *buf, size_t len)
+{
+    struct ShmTransport *s = (struct ShmTransport *)t->impl;
+    assert(root < s->nranks && len <= s->max_msg);
+
+    if (s->rank != root) {
+        return shm_recv(t, root, buf, len);
+    }
+
+    if (shm_slot_wait(s) != 0) return -1;
+    memcpy(slot(s, s->rank), buf, len);
+    for (size_t i = 0; i < nranks; ++i) {
+        if (ranks[i] == root) continue;
+        s->readers[ranks[i]] = 1;
+        if (shm_notify(s, ranks[i], MSG_DATA) != 0) return -1;
+    }
+    return 0;
+}
+
+static void shm_close(struct MatrixTransport *t)
+{
+    struct ShmTransport *s = (struct ShmTransport *)t->impl;
+    if (!s) return;
+
+    for (size_t r = 0; r < s->nranks; ++r) {
+        close_fd(&s->note_rx[r]);
+        close_fd(&s->note_tx[r]);
+        close_fd(&s->alive_rd[r]);
+        close_fd(&s->alive_wr[r]);
+    }
+    munmap(s->mem, s->mem_size);
+    free(s->pending);
+    free(s->readers);
+    free(s->alive_wr);
+    free(s->alive_rd);
+    free(s->note_tx);
+    free(s->note_rx);
+    free(s);
+    t->impl = NULL;
+}
+
+struct MatrixTransport matrix_transport_shm(void)
+{
+    struct MatrixTransport t = { shm_open_transport, shm_attach, shm_send, shm_recv, shm_bcast, shm_close, NULL };
+    return t;
+}
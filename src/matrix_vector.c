@@ -0,0 +1,131 @@
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <unistd.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <assert.h>
+#include <stdlib.h>
+
+#include "matrix.h"
+#include "matrix_internal.h"
+
+/* Matrix-vector kernels on plain int arrays, so vectors do not go through
+   n x 1 matrices. Sums are kept in unsigned, which wraps the same way the
+   int matrix kernels do in practice but without undefined behaviour, and
+   leaves the inner loops free for the compiler to vectorize. */
+
+/* ---------------- worker arg ---------------- */
+struct VecArg {
+    const struct Matrix *A;
+    const int *x;
+    int *y;
+    size_t begin;   // rows (gemv) or columns (gevm), inclusive
+    size_t end;     // exclusive
+};
+
+/* y[i] += dot(A[i], x) for rows [begin, end) */
+static void *gemv_worker(void *varg)
+{
+    struct VecArg *arg = (struct VecArg *)varg;
+    const size_t n = arg->A->n;
+    const int *restrict x = arg->x;
+
+    for (size_t i = arg->begin; i < arg->end; ++i) {
+        const int *restrict row = arg->A->arr[i];
+        unsigned sum = 0;
+        for (size_t j = 0; j < n; ++j) {
+            sum += (unsigned)row[j] * (unsigned)x[j];
+        }
+        arg->y[i] = (int)((unsigned)arg->y[i] + sum);
+    }
+
+    return NULL;
+}
+
+/* y[j] += sum_i x[i] * A[i][j] for columns [begin, end): every row is an
+   axpy over the thread's column chunk, which stays in cache */
+static void *gevm_worker(void *varg)
+{
+    struct VecArg *arg = (struct VecArg *)varg;
+    const size_t m = arg->A->m;
+    unsigned *restrict y = (unsigned *)arg->y;
+
+    for (size_t i = 0; i < m; ++i) {
+        const int *restrict row = arg->A->arr[i];
+        unsigned xi = (unsigned)arg->x[i];
+        for (size_t j = arg->begin; j < arg->end; ++j) {
+            y[j] += xi * (unsigned)row[j];
+        }
+    }
+
+    return NULL;
+}
+
+/* Runs worker over [0, len) split in nthreads chunks of `unit` elements */
+static void vec_pthread_generic(const struct Matrix *A, const int *x, int *y, size_t len, size_t unit,
+                                size_t nthreads, void *(*worker)(void *))
+{
+    nthreads = detect_threads(nthreads);
+
+    size_t units = (len + unit - 1) / unit;
+    if (nthreads > units) nthreads = units;
+    if (nthreads == 0) nthreads = 1;
+
+    // If nthreads is 1, fallback to single-threaded kernel (to avoid thread overhead)
+    if (nthreads == 1) {
+        struct VecArg arg = { A, x, y, 0, len };
+        worker(&arg);
+        return;
+    }
+
+    pthread_t *threads = (pthread_t *)calloc(nthreads, sizeof(pthread_t));
+    assert(threads);
+    struct VecArg *args = (struct VecArg *)calloc(nthreads, sizeof(struct VecArg));
+    assert(args);
+
+    size_t base = units / nthreads;
+    size_t rem = units % nthreads;
+    size_t cur = 0;
+    for (size_t t = 0; t < nthreads; ++t) {
+        size_t chunk = base + (t < rem ? 1 : 0);
+        args[t].A = A;
+        args[t].x = x;
+        args[t].y = y;
+        args[t].begin = cur * unit;
+        args[t].end = (cur + chunk) * unit;
+        if (args[t].end > len) args[t].end = len;
+        cur += chunk;
+
+        int rc = pthread_create(&threads[t], NULL, worker, &args[t]);
+        if (rc != 0) {
+            // fallback: run in main thread if create failed
+            worker(&args[t]);
+            threads[t] = 0;
+        }
+    }
+
+    for (size_t t = 0; t < nthreads; ++t) {
+        if (threads[t]) pthread_join(threads[t], NULL);
+    }
+
+    free(threads);
+    free(args);
+}
+
+/* y += A * x; x has A->n elements, y has A->m */
+void matrix_gemv(const struct Matrix *A, const int *x, int *y, size_t nthreads)
+{
+    assert(A && x && y);
+
+    vec_pthread_generic(A, x, y, A->m, 1, nthreads, gemv_worker);
+}
+
+/* y += x^T * A; x has A->m elements, y has A->n.
+   Threads own chunks of y made of whole cache lines (for aligned y). */
+void matrix_gevm(const int *x, const struct Matrix *A, int *y, size_t nthreads)
+{
+    assert(A && x && y);
+
+    vec_pthread_generic(A, x, y, A->n, COLS_PER_LINE, nthreads, gevm_worker);
+}
@@ -0,0 +1,253 @@
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <unistd.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "matrix.h"
+#include "matrix_internal.h"
+
+/* Freivalds' check: for a random 0/1 vector x, A * (B * x) == C * x holds
+   for a correct C, and fails with probability >= 1/2 per round otherwise.
+   Everything is computed in unsigned arithmetic, i.e. modulo 2^32, which is
+   exactly what the int kernels produce when they overflow, and the 1/2
+   bound holds over that ring as well. Cost is O(mk + kn + mn) per round
+   instead of O(mkn) for recomputing the product. */
+
+static atomic_size_t verify_rounds;
+
+void matrix_set_verify(size_t rounds)
+{
+    atomic_store(&verify_rounds, rounds);
+}
+
+size_t matrix_get_verify(void)
+{
+    return atomic_load(&verify_rounds);
+}
+
+/* ---------------- random 0/1 vectors ---------------- */
+
+static uint64_t verify_seed(void)
+{
+    static atomic_uint_fast64_t calls;
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    uint64_t seed = (uint64_t)ts.tv_nsec ^ ((uint64_t)ts.tv_sec << 32);
+    seed ^= (atomic_fetch_add(&calls, 1) + 1) * 0x9E3779B97F4A7C15ull;
+    return seed ? seed : 1;
+}
+
+static void fill_random_bits(unsigned *x, size_t len)
+{
+    uint64_t s = verify_seed();
+    uint64_t bits = 0;
+
+    for (size_t i = 0; i < len; ++i) {
+        if (i % 64 == 0) {
+            /* xorshift64 */
+            s ^= s << 13;
+            s ^= s >> 7;
+            s ^= s << 17;
+            bits = s;
+        }
+        x[i] = (unsigned)(bits & 1u);
+        bits >>= 1;
+    }
+}
+
+/* ---------------- parallel matrix * vectors ---------------- */
+
+/* Y[r][i] = sum_j M[i][j] * X[r][j] for r < nvec.
+   X is nvec x M->n, Y is nvec x M->m, both row-major. */
+struct MatvecArg {
+    const struct Matrix *M;
+    const unsigned *X;
+    unsigned *Y;
+    size_t nvec;
+    size_t row_begin;
+    size_t row_end;
+};
+
+static void *matvec_worker(void *varg)
+{
+    struct MatvecArg *arg = (struct MatvecArg *)varg;
+    const size_t rows = arg->M->m;
+    const size_t cols = arg->M->n;
+
+    for (size_t i = arg->row_begin; i < arg->row_end; ++i) {
+        const int *restrict row = arg->M->arr[i];
+
+        /* every vector reuses the row while it is hot; the dot product is
+           a plain contiguous unsigned loop, which the compiler vectorizes */
+        for (size_t r = 0; r < arg->nvec; ++r) {
+            const unsigned *restrict x = arg->X + r * cols;
+            unsigned sum = 0;
+            for (size_t j = 0; j < cols; ++j) {
+                sum += (unsigned)row[j] * x[j];
+            }
+            arg->Y[r * rows + i] = sum;
+        }
+    }
+
+    return NULL;
+}
+
+static void matvecs_pthread(const struct Matrix *M, const unsigned *X, unsigned *Y, size_t nvec, size_t nthreads)
+{
+    if (nthreads > M->m) nthreads = M->m;
+    if (nthreads == 0) nthreads = 1;
+
+    if (nthreads == 1) {
+        struct MatvecArg single = { M, X, Y, nvec, 0, M->m };
+        matvec_worker(&single);
+        return;
+    }
+
+    pthread_t *threads = (pthread_t *)calloc(nthreads, sizeof(pthread_t));
+    assert(threads);
+    struct MatvecArg *args = (struct MatvecArg *)calloc(nthreads, sizeof(struct MatvecArg));
+    assert(args);
+
+    size_t base = M->m / nthreads;
+    size_t rem = M->m % nthreads;
+    size_t cur = 0;
+    for (size_t t = 0; t < nthreads; ++t) {
+        size_t chunk = base + (t < rem ? 1 : 0);
+        args[t].M = M;
+        args[t].X = X;
+        args[t].Y = Y;
+        args[t].nvec = nvec;
+        args[t].row_begin = cur;
+        args[t].row_end = cur + chunk;
+        cur += chunk;
+
+        int rc = pthread_create(&threads[t], NULL, matvec_worker, &args[t]);
+        if (rc != 0) {
+            /* fallback run in main thread */
+            matvec_worker(&args[t]);
+            threads[t] = 0;
+        }
+    }
+
+    for (size_t t = 0; t < nthreads; ++t) {
+        if (threads[t]) pthread_join(threads[t], NULL);
+    }
+
+    free(threads);
+    free(args);
+}
+
+/* 1 if alpha * A * bx + c0x == C * x for all rounds, where bx = B * x was
+   computed by the caller; c0x may be NULL (zero) */
+static int verify_check(const struct Matrix *A, const unsigned *bx, const struct Matrix *C, int alpha,
+                        const unsigned *x, const unsigned *c0x, size_t rounds, size_t nthreads)
+{
+    unsigned *abx = (unsigned *)calloc(rounds * A->m, sizeof(unsigned));
+    unsigned *cx = (unsigned *)calloc(rounds * C->m, sizeof(unsigned));
+    assert(abx && cx);
+
+    matvecs_pthread(A, bx, abx, rounds, nthreads);
+    matvecs_pthread(C, x, cx, rounds, nthreads);
+
+    int ok = 1;
+    for (size_t e = 0; e < rounds * C->m && ok; ++e) {
+        unsigned expected = (unsigned)alpha * abx[e] + (c0x ? c0x[e] : 0u);
+        ok = (expected == cx[e]);
+    }
+
+    free(cx);
+    free(abx);
+    return ok;
+}
+
+/* ---------------- public API ---------------- */
+
+int matrix_verify_product(const struct Matrix *A, const struct Matrix *B, const struct Matrix *C, size_t rounds, size_t nthreads)
+{
+    assert(A && B && C);
+    assert(A->n == B->m && A->m == C->m && B->n == C->n);
+
+    if (rounds == 0) rounds = 1;
+    nthreads = detect_threads(nthreads);
+
+    unsigned *x = (unsigned *)calloc(rounds * C->n, sizeof(unsigned));
+    assert(x);
+    fill_random_bits(x, rounds * C->n);
+
+    unsigned *bx = (unsigned *)calloc(rounds * B->m, sizeof(unsigned));
+    assert(bx);
+    matvecs_pthread(B, x, bx, rounds, nthreads);
+
+    int ok = verify_check(A, bx, C, 1, x, NULL, rounds, nthreads);
+
+    free(bx);
+    free(x);
+    return ok;
+}
+
+/* ---------------- verify mode hooks ---------------- */
+
+void matrix_verify_begin(struct MatrixVerify *v, const struct Matrix *C, int accumulates, int alpha, size_t nthreads)
+{
+    assert(v && C);
+
+    v->rounds = matrix_get_verify();
+    v->alpha = alpha;
+    v->x = NULL;
+    v->c0x = NULL;
+    if (v->rounds == 0) return;
+
+    v->x = (unsigned *)calloc(v->rounds * C->n, sizeof(unsigned));
+    assert(v->x);
+    fill_random_bits(v->x, v->rounds * C->n);
+
+    if (accumulates) {
+        v->c0x = (unsigned *)calloc(v->rounds * C->m, sizeof(unsigned));
+        assert(v->c0x);
+        matvecs_pthread(C, v->x, v->c0x, v->rounds, detect_threads(nthreads));
+    }
+}
+
+struct Matrix *matrix_verify_end(struct MatrixVerify *v, const struct Matrix *A, const struct Matrix *B, struct Matrix *C, size_t nthreads)
+{
+    assert(v);
+
+    if (v->rounds == 0) return C;
+
+    unsigned *bx = (unsigned *)calloc(v->rounds * B->m, sizeof(unsigned));
+    assert(bx);
+    matvecs_pthread(B, v->x, bx, v->rounds, detect_threads(nthreads));
+
+    struct Matrix *result = matrix_verify_end_bx(v, A, bx, C, nthreads);
+
+    free(bx);
+    return result;
+}
+
+struct Matrix *matrix_verify_end_bx(struct MatrixVerify *v, const struct Matrix *A, const unsigned *bx, struct Matrix *C, size_t nthreads)
+{
+    assert(v);
+
+    if (v->rounds == 0) return C;
+
+    int ok = verify_check(A, bx, C, v->alpha, v->x, v->c0x, v->rounds, detect_threads(nthreads));
+
+    free(v->x);
+    free(v->c0x);
+    v->x = NULL;
+    v->c0x = NULL;
+
+    if (!ok) {
+        fprintf(stderr, "[verify] %zux%zu product failed Freivalds check (%zu rounds)\n", C->m, C->n, v->rounds);
+        return NULL;
+    }
+    return C;
+}
@@ -0,0 +1,458 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/resource.h>
+
+#include "matrix.h"
+
+/* Checks the multiplication entry points against the single-threaded
+   reference mul_matrices_cache_friendly_most2() on odd shapes: a single
+   row, a huge inner dimension with a tiny C, and block sizes that do not
+   divide the matrix. Values are small, so nothing overflows. */
+
+static int failures;
+
+#define CHECK(cond, ...) do {                           \
+        if (!(cond)) {                                  \
+            printf("[FAIL] %s:%d: ", __FILE__, __LINE__); \
+            printf(__VA_ARGS__);                        \
+            printf("\n");                               \
+            ++failures;                                 \
+        }                                               \
+    } while (0)
+
+static const size_t shapes[][3] = {
+    /* M, K, N */
+    {1, 1, 1},
+    {1, 300, 1},
+    {1, 257, 5},
+    {2, 3000, 3},
+    {17, 33, 9},
+    {40, 7, 70},
+    {65, 129, 31},
+};
+static const size_t nshapes = sizeof(shapes) / sizeof(shapes[0]);
+
+static const size_t block_sizes[] = {0, 5, 7, 64};
+static const size_t nblock_sizes = sizeof(block_sizes) / sizeof(block_sizes[0]);
+
+static const size_t thread_counts[] = {1, 3, 0};
+static const size_t nthread_counts = sizeof(thread_counts) / sizeof(thread_counts[0]);
+
+static int matrix_equal(const struct Matrix *X, const struct Matrix *Y)
+{
+    if (!X || !Y || X->m != Y->m || X->n != Y->n) return 0;
+    for (size_t i = 0; i < X->m; ++i) {
+        if (memcmp(X->arr[i], Y->arr[i], X->n * sizeof(int)) != 0) return 0;
+    }
+    return 1;
+}
+
+static struct Matrix *reference(const struct Matrix *A, const struct Matrix *B)
+{
+    struct Matrix *R = matrix_ctor(A->m, B->n);
+    mul_matrices_cache_friendly_most2(A, B, R);
+    return R;
+}
+
+static struct Matrix *transpose(const struct Matrix *A)
+{
+    struct Matrix *T = matrix_ctor(A->n, A->m);
+    for (size_t i = 0; i < A->m; ++i) {
+        for (size_t j = 0; j < A->n; ++j) {
+            T->arr[j][i] = A->arr[i][j];
+        }
+    }
+    return T;
+}
+
+/* ---------------- packed right operand ---------------- */
+
+static void test_packed(const struct Matrix *A, const struct Matrix *B, const struct Matrix *R, size_t nthreads, size_t bs)
+{
+    struct MatrixPacked *P = matrix_pack(B, bs);
+    CHECK(matrix_packed_footprint(P) >= B->m * B->n * sizeof(int), "packed footprint");
+
+    struct Matrix *C = matrix_ctor(A->m, B->n);
+    CHECK(mul_matrices_packed_pthread(A, P, C, nthreads) == C && matrix_equal(C, R),
+          "packed_pthread %zux%zux%zu, %zu threads, bs %zu", A->m, A->n, B->n, nthreads, bs);
+    matrix_dtor(C);
+
+    C = matrix_ctor(A->m, B->n);
+    CHECK(mul_matrices_packed(A, P, C) == C && matrix_equal(C, R), "packed bs %zu", bs);
+    matrix_dtor(C);
+
+    matrix_packed_dtor(P);
+}
+
+/* ---------------- row / column / 2D grid kernels ---------------- */
+
+static void test_mt(const struct Matrix *A, const struct Matrix *B, const struct Matrix *R, size_t nthreads)
+{
+    struct Matrix *(*kernels[])(const struct Matrix *, const struct Matrix *, struct Matrix *, size_t) = {
+        mul_matrices_pthread, mul_matrices_bad_mt, mul_matrices_cache_friendly_mt, mul_matrices_cache_friendly_most_mt,
+    };
+    for (size_t t = 0; t < sizeof(kernels) / sizeof(kernels[0]); ++t) {
+        struct Matrix *C = matrix_ctor(A->m, B->n);
+        CHECK(kernels[t](A, B, C, nthreads) == C && matrix_equal(C, R),
+              "mt kernel %zu, %zux%zux%zu, %zu threads", t, A->m, A->n, B->n, nthreads);
+        matrix_dtor(C);
+    }
+}
+
+static void test_blocked(const struct Matrix *A, const struct Matrix *B, const struct Matrix *R, size_t nthreads, size_t bs)
+{
+    struct Matrix *C = matrix_ctor(A->m, B->n);
+    CHECK(mul_matrices_blocked_pthread(A, B, C, nthreads, bs) == C && matrix_equal(C, R),
+          "blocked_pthread %zux%zux%zu, %zu threads, bs %zu", A->m, A->n, B->n, nthreads, bs);
+    matrix_dtor(C);
+
+    C = matrix_ctor(A->m, B->n);
+    CHECK(mul_matrices_blocked(A, B, C, bs) == C && matrix_equal(C, R), "blocked bs %zu", bs);
+    matrix_dtor(C);
+}
+
+/* ---------------- split-K ---------------- */
+
+static void test_splitk(const struct Matrix *A, const struct Matrix *B, const struct Matrix *R, size_t nthreads, size_t bs)
+{
+    struct Matrix *C = matrix_ctor(A->m, B->n);
+    CHECK(mul_matrices_splitk_pthread(A, B, C, nthreads, bs) == C && matrix_equal(C, R),
+          "splitk_pthread %zux%zux%zu, %zu threads, bs %zu", A->m, A->n, B->n, nthreads, bs);
+    matrix_dtor(C);
+}
+
+/* ---------------- SYRK ---------------- */
+
+static void test_syrk(const struct Matrix *A, size_t nthreads, size_t bs)
+{
+    struct Matrix *T = transpose(A);
+    struct Matrix *R = reference(A, T);
+
+    for (int uplo = MATRIX_UPPER; uplo <= MATRIX_LOWER; ++uplo) {
+        for (int mirror = 0; mirror <= 1; ++mirror) {
+            struct Matrix *C = matrix_ctor(A->m, A->m);
+            CHECK(mul_matrices_syrk_pthread(A, C, (enum MatrixUplo)uplo, mirror, nthreads, bs) == C,
+                  "syrk_pthread returned NULL");
+
+            int ok = 1;
+            for (size_t i = 0; i < A->m; ++i) {
+                for (size_t j = 0; j < A->m; ++j) {
+                    int in_triangle = uplo == MATRIX_LOWER ? j <= i : j >= i;
+                    int expected = (in_triangle || mirror) ? R->arr[i][j] : 0;
+                    if (C->arr[i][j] != expected) ok = 0;
+                }
+            }
+            CHECK(ok, "syrk %zux%zu uplo %d mirror %d, %zu threads, bs %zu", A->m, A->n, uplo, mirror, nthreads, bs);
+            matrix_dtor(C);
+        }
+    }
+
+    struct Matrix *C = matrix_ctor(A->m, A->m);
+    CHECK(mul_matrices_syrk(A, C, MATRIX_LOWER, 1, bs) == C && matrix_equal(C, R), "syrk bs %zu", bs);
+    matrix_dtor(C);
+
+    matrix_dtor(R);
+    matrix_dtor(T);
+}
+
+/* ---------------- verification ---------------- */
+
+static void test_verify(const struct Matrix *A, const struct Matrix *B, const struct Matrix *R)
+{
+    CHECK(matrix_verify_product(A, B, R, 4, 0) == 1, "verify of a correct product");
+
+    struct Matrix *W = reference(A, B);
+    W->arr[W->m - 1][W->n - 1] += 1;
+    CHECK(matrix_verify_product(A, B, W, 32, 0) == 0, "verify of a wrong product");
+    matrix_dtor(W);
+
+    /* verify mode must accept the correct results of the kernels */
+    matrix_set_verify(2);
+    test_packed(A, B, R, 3, 7);
+    test_mt(A, B, R, 3);
+    test_blocked(A, B, R, 3, 7);
+    test_splitk(A, B, R, 3, 7);
+    test_syrk(A, 3, 7);
+    matrix_set_verify(0);
+}
+
+/* ---------------- async ---------------- */
+
+static void test_async(const struct Matrix *A, const struct Matrix *B, const struct Matrix *R)
+{
+    struct Matrix *T = transpose(B);
+    struct Matrix *RT = reference(R, T);
+
+    /* D = (A * B) * B^T, chained; restarted after a shutdown */
+    for (int round = 0; round < 2; ++round) {
+        struct Matrix *C = matrix_ctor(A->m, B->n);
+        struct Matrix *D = matrix_ctor(A->m, B->m);
+        struct MatrixFuture *fc = mul_matrices_submit(A, B, C, 0, 7, NULL, NULL, NULL);
+        struct MatrixFuture *fd = mul_matrices_submit(C, T, D, 2, 5, fc, NULL, NULL);
+
+        CHECK(matrix_future_wait(fd) == D && matrix_equal(D, RT), "async chain, round %d", round);
+        CHECK(matrix_future_poll(fc) == 1 && matrix_future_wait(fc) == C && matrix_equal(C, R),
+              "async first job, round %d", round);
+
+        matrix_future_dtor(fd);
+        matrix_future_dtor(fc);
+        matrix_async_shutdown();
+        matrix_dtor(D);
+        matrix_dtor(C);
+    }
+
+    matrix_dtor(RT);
+    matrix_dtor(T);
+}
+
+/* ---------------- scaled GEMM and lazy expressions ---------------- */
+
+static void test_scaled(const struct Matrix *A, const struct Matrix *B, const struct Matrix *R, size_t nthreads)
+{
+    /* C += 3 * A * B on top of existing values */
+    struct Matrix *C = matrix_ctor(A->m, B->n);
+    struct Matrix *E = matrix_ctor(A->m, B->n);
+    matrix_fill(C, 2);
+    for (size_t i = 0; i < E->m; ++i) {
+        for (size_t j = 0; j < E->n; ++j) {
+            E->arr[i][j] = 2 + 3 * R->arr[i][j];
+        }
+    }
+    CHECK(mul_matrices_scaled_mt(A, B, C, 3, nthreads) == C && matrix_equal(C, E),
+          "scaled_mt %zux%zux%zu, %zu threads", A->m, A->n, B->n, nthreads);
+    matrix_dtor(E);
+    matrix_dtor(C);
+}
+
+static void test_expr(const struct Matrix *A, const struct Matrix *B)
+{
+    /* 2 * (A * B) * B^T + A * (B * B^T) == 3 * A * B * B^T */
+    struct Matrix *T = transpose(B);
+    struct Matrix *AB = reference(A, B);
+    struct Matrix *R = reference(AB, T);
+
+    struct MatrixExpr *e = matrix_expr_add(
+        matrix_expr_scale(matrix_expr_mul(matrix_expr_mul(matrix_expr_leaf(A), matrix_expr_leaf(B)), matrix_expr_leaf(T)), 2),
+        matrix_expr_mul(matrix_expr_leaf(A), matrix_expr_mul(matrix_expr_leaf(B), matrix_expr_leaf(T))));
+    struct Matrix *C = matrix_expr_eval(e, 3);
+
+    matrix_mul_val(R, 3);
+    CHECK(matrix_equal(C, R), "expr %zux%zux%zu", A->m, A->n, B->n);
+
+    if (C) matrix_dtor(C);
+    matrix_expr_dtor(e);
+    matrix_dtor(R);
+    matrix_dtor(AB);
+    matrix_dtor(T);
+}
+
+/* ---------------- matrix power and matrix-vector ---------------- */
+
+static void test_pow(void)
+{
+    struct Matrix *A = matrix_generate(9, 9, 2);
+    struct Matrix *R = matrix_eye(9);
+
+    for (unsigned p = 0; p <= 6; ++p) {
+        struct Matrix *P = matrix_pow(A, p, 3);
+        CHECK(matrix_equal(P, R), "pow %u", p);
+        if (P) matrix_dtor(P);
+
+        struct Matrix *next = reference(R, A);
+        matrix_dtor(R);
+        R = next;
+    }
+
+    matrix_dtor(R);
+    matrix_dtor(A);
+}
+
+static void test_vector(const struct Matrix *A, size_t nthreads)
+{
+    size_t len = A->n > A->m ? A->n : A->m;
+    int *x = (int *)calloc(len, sizeof(int));
+    int *y = (int *)calloc(len, sizeof(int));
+    int *expected = (int *)calloc(len, sizeof(int));
+
+    for (size_t j = 0; j < A->n; ++j) x[j] = (int)(j % 7) - 3;
+    for (size_t i = 0; i < A->m; ++i) {
+        y[i] = 1;
+        expected[i] = 1;
+        for (size_t j = 0; j < A->n; ++j) expected[i] += A->arr[i][j] * x[j];
+    }
+    matrix_gemv(A, x, y, nthreads);
+    CHECK(memcmp(y, expected, A->m * sizeof(int)) == 0, "gemv %zux%zu, %zu threads", A->m, A->n, nthreads);
+
+    for (size_t i = 0; i < A->m; ++i) x[i] = (int)(i % 5) - 2;
+    for (size_t j = 0; j < A->n; ++j) {
+        y[j] = 1;
+        expected[j] = 1;
+        for (size_t i = 0; i < A->m; ++i) expected[j] += x[i] * A->arr[i][j];
+    }
+    matrix_gevm(x, A, y, nthreads);
+    CHECK(memcmp(y, expected, A->n * sizeof(int)) == 0, "gevm %zux%zu, %zu threads", A->m, A->n, nthreads);
+
+    free(expected);
+    free(y);
+    free(x);
+}
+
+/* ---------------- SUMMA ---------------- */
+
+static void test_summa(const struct Matrix *A, const struct Matrix *B, const struct Matrix *R)
+{
+    for (size_t grid = 1; grid <= 3; ++grid) {
+        if (grid > A->m || grid > A->n || grid > B->n) continue;
+
+        for (int own_bcast = 0; own_bcast <= 1; ++own_bcast) {
+            struct MatrixTransport tr = matrix_transport_shm();
+            if (!own_bcast) tr.bcast = NULL;     /* point-to-point fallback */
+
+            struct Matrix *C = matrix_ctor(A->m, B->n);
+            CHECK(mul_matrices_summa(A, B, C, grid, &tr, 5) == C && matrix_equal(C, R),
+                  "summa %zux%zux%zu, grid %zu, bcast %d", A->m, A->n, B->n, grid, own_bcast);
+            matrix_dtor(C);
+        }
+    }
+}
+
+static struct MatrixTransport shm;
+static size_t attached_rank;
+
+static int attach_and_remember(struct MatrixTransport *t, size_t rank)
+{
+    attached_rank = rank;
+    return shm.attach(t, rank);
+}
+
+/* the last rank fails to hand in its block of C */
+static int send_but_last_block(struct MatrixTransport *t, size_t dst, const void *buf, size_t len)
+{
+    return attached_rank == 8 && dst == 0 ? -1 : shm.send(t, dst, buf, len);
+}
+
+/* a failing rank makes the others bail out and leaves C alone */
+static void test_summa_failure(void)
+{
+    struct Matrix *A = matrix_generate(9, 8, 10);
+    struct Matrix *B = matrix_generate(8, 7, 10);
+    struct Matrix *C = matrix_generate(9, 7, 10);
+    struct Matrix *C0 = matrix_ctor(9, 7);
+    for (size_t i = 0; i < C->m; ++i) memcpy(C0->arr[i], C->arr[i], C->n * sizeof(int));
+
+    shm = matrix_transport_shm();
+    shm.bcast = NULL;       /* every send goes through the hook */
+    struct MatrixTransport tr = shm;
+    tr.attach = attach_and_remember;
+    tr.send = send_but_last_block;
+    CHECK(mul_matrices_summa(A, B, C, 3, &tr, 5) == NULL && matrix_equal(C, C0), "summa with a failing rank");
+
+    matrix_dtor(C0);
+    matrix_dtor(C);
+    matrix_dtor(B);
+    matrix_dtor(A);
+}
+
+/* grids as large as a many-core node would use, under the usual limit of
+   1024 descriptors */
+static void test_summa_wide(void)
+{
+    struct rlimit old, lim;
+    int limited = getrlimit(RLIMIT_NOFILE, &old) == 0;
+    if (limited) {
+        lim = old;
+        if (lim.rlim_cur > 1024) lim.rlim_cur = 1024;
+        limited = setrlimit(RLIMIT_NOFILE, &lim) == 0;
+    }
+
+    struct Matrix *A = matrix_generate(37, 29, 10);
+    struct Matrix *B = matrix_generate(29, 31, 10);
+    struct Matrix *R = reference(A, B);
+    const size_t grids[] = {6, 8};
+
+    for (size_t g = 0; g < sizeof(grids) / sizeof(grids[0]); ++g) {
+        struct Matrix *C = matrix_ctor(A->m, B->n);
+        CHECK(mul_matrices_summa(A, B, C, grids[g], NULL, 5) == C && matrix_equal(C, R),
+              "summa %zux%zux%zu, grid %zu", A->m, A->n, B->n, grids[g]);
+        matrix_dtor(C);
+    }
+
+    matrix_dtor(R);
+    matrix_dtor(B);
+    matrix_dtor(A);
+    if (limited) setrlimit(RLIMIT_NOFILE, &old);
+}
+
+/* ---------------- tracing ---------------- */
+
+static void test_trace(void)
+{
+    const char *path = "matrix_trace_test.json";
+    struct Matrix *A = matrix_generate(37, 41, 10);
+    struct Matrix *B = matrix_generate(41, 29, 10);
+    struct Matrix *C = matrix_ctor(A->m, B->n);
+
+    matrix_trace_enable(64);
+    mul_matrices_blocked_pthread(A, B, C, 3, 5);
+    mul_matrices_cache_friendly_most_mt(A, B, C, 3);
+    matrix_trace_disable();
+    CHECK(matrix_trace_dump(path) == 0, "trace dump");
+
+    FILE *fin = fopen(path, "r");
+    char buf[64] = {0};
+    CHECK(fin && fgets(buf, sizeof(buf), fin) && strstr(buf, "traceEvents"), "trace file header");
+    if (fin) fclose(fin);
+    remove(path);
+
+    matrix_dtor(C);
+    matrix_dtor(B);
+    matrix_dtor(A);
+}
+
+int main() {
+    srand(time(NULL));
+
+    for (size_t s = 0; s < nshapes; ++s) {
+        const size_t M = shapes[s][0], K = shapes[s][1], N = shapes[s][2];
+        printf("[DEBUG] shape %zux%zux%zu..\n", M, K, N);
+
+        struct Matrix *A = matrix_generate(M, K, 10);
+        struct Matrix *B = matrix_generate(K, N, 10);
+        struct Matrix *R = reference(A, B);
+
+        for (size_t t = 0; t < nthread_counts; ++t) {
+            test_mt(A, B, R, thread_counts[t]);
+            test_scaled(A, B, R, thread_counts[t]);
+            test_vector(A, thread_counts[t]);
+            for (size_t b = 0; b < nblock_sizes; ++b) {
+                test_packed(A, B, R, thread_counts[t], block_sizes[b]);
+                test_blocked(A, B, R, thread_counts[t], block_sizes[b]);
+                test_splitk(A, B, R, thread_counts[t], block_sizes[b]);
+                test_syrk(A, thread_counts[t], block_sizes[b]);
+            }
+        }
+
+        test_verify(A, B, R);
+        test_async(A, B, R);
+        test_expr(A, B);
+        test_summa(A, B, R);
+
+        matrix_dtor(R);
+        matrix_dtor(B);
+        matrix_dtor(A);
+    }
+
+    test_pow();
+    test_summa_failure();
+    test_summa_wide();
+    test_trace();
+
+    if (failures) {
+        printf("%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("All checks passed\n");
+    return 0;
+}